@@ -1,4 +1,5 @@
 #!/usr/bin/python3
+import struct
 import sys
 import numpy as np
 import matplotlib.pyplot as plt
@@ -11,9 +12,23 @@ file_velA = "res_velA.out"
 
 resolution=400
 
-data_len = np.loadtxt(file_len)
-data_vel = np.loadtxt(file_vel)
-data_vA2 = np.loadtxt(file_velA)
+
+# results in either RESULTS_FORMAT, returns the data columns and the header text
+def load_results(path):
+    with open(path, 'rb') as f:
+        magic = f.read(8)
+        if magic != b'PTDRES\0\0':
+            return np.loadtxt(path), open(path, 'r').read()
+        version, columns, text_size = struct.unpack('<IIQ', f.read(16))
+        header = f.read(text_size).decode().rstrip('\0')
+    data = np.fromfile(path, dtype='<f8', offset=24 + text_size)
+    rows = data.size // columns
+    return data[:rows * columns].reshape(rows, columns), header
+
+
+data_len, header_len = load_results(file_len)
+data_vel, header_vel = load_results(file_vel)
+data_vA2, header_vA2 = load_results(file_velA)
 
 plt.clf()
 plt.plot(data_len[:, 0], data_len[:, 3], linewidth=0.7, color='b', label="length")
@@ -62,15 +77,15 @@ len_omega = 0.0
 vel_omega = 0.0
 vA2_omega = 0.0
 
-for item in open(file_len, 'r').readlines():
+for item in header_len.splitlines():
     if "OPT_OMEGA_EV" in item:
             len_omega = float(item.split()[-1]) * ev_to_au
 
-for item in open(file_vel, 'r').readlines():
+for item in header_vel.splitlines():
     if "OPT_OMEGA_EV" in item:
             vel_omega = float(item.split()[-1]) * ev_to_au
 
-for item in open(file_velA, 'r').readlines():
+for item in header_vA2.splitlines():
     if "OPT_OMEGA_EV" in item:
             vA2_omega = float(item.split()[-1]) * ev_to_au
 
@@ -25,14 +25,16 @@ INPS="$HERE/inps"
 PLOTS="$HERE/plots"
 LOGS="$HERE/logs"
 DUMPS="$HERE/dumps"
+CACHE="$HERE/cache"
 SETTINGS_FILE="settings.inp"
 JOB_NAME=$1
 
-mkdir $INPS $LOGS $DUMPS
+mkdir $INPS $LOGS $DUMPS $CACHE
 
 sed -i -e "s/^JOB_NAME .*/JOB_NAME                        ${JOB_NAME}/g" $SETTINGS_FILE
 sed -i -e "s|^RESOURCES_PATH .*|RESOURCES_PATH                        ${INTS}|g" $SETTINGS_FILE
 sed -i -e "s|^OUT_PATH .*|OUT_PATH                        ${HERE}|g" $SETTINGS_FILE
+sed -i -e "s|^CACHE_PATH .*|CACHE_PATH                        ${CACHE}|g" $SETTINGS_FILE
 
 if [ "$REPRESENTATION" -eq 1 ]; then
     echo " Using spherical representation."
@@ -74,47 +76,28 @@ fi
 
 cd $INPS
 
-echo " Computing propagation."
-
-#velocityA gauge
-sed -i -e "s|^GAUGE .*|GAUGE                        velocity_with_Asqrt|g" $SETTINGS_FILE
-sed -i -e "s|^OUT_FILE .*|OUT_FILE                        res_velA.out|g" $SETTINGS_FILE
-mkdir ${DUMPS}/velA
-sed -i -e "s|^DUMP_PATH .*|DUMP_PATH                        ${DUMPS}/velA/|g" $SETTINGS_FILE
-
-
-$PHOTO_TD_PATH./main $SETTINGS_FILE >$LOGS/log_td_velA.out
-
-if [ "$?" -ne 0 ]; then
-    echo " Velocity with A^2 gauge computation (photo_td) failed."
-    exit 1
-fi
-
-
-#length gauge
-sed -i -e "s|^GAUGE .*|GAUGE                        length|g" $SETTINGS_FILE
-sed -i -e "s|^OUT_FILE .*|OUT_FILE                        res_len.out|g" $SETTINGS_FILE
-mkdir ${DUMPS}/len
-sed -i -e "s|^DUMP_PATH .*|DUMP_PATH                        ${DUMPS}/len|g" $SETTINGS_FILE
-
-$PHOTO_TD_PATH./main $SETTINGS_FILE >$LOGS/log_td_len.out
+echo " Converting integrals to the native format."
+sed -i -e "s|^INTEGRALS_FORMAT .*|INTEGRALS_FORMAT                        xgtopw|g" $SETTINGS_FILE
+$PHOTO_TD_PATH./main $SETTINGS_FILE -convert >$LOGS/log_convert.out
 
 if [ "$?" -ne 0 ]; then
-    echo " Length gauge computation (photo_td) failed."
+    echo " Conversion of integrals (photo_td) failed."
     exit 1
 fi
+sed -i -e "s|^INTEGRALS_FORMAT .*|INTEGRALS_FORMAT                        native|g" $SETTINGS_FILE
 
+echo " Computing propagation."
 
-#velocity gauge
-sed -i -e "s|^GAUGE .*|GAUGE                        velocity|g" $SETTINGS_FILE
-sed -i -e "s|^OUT_FILE .*|OUT_FILE                        res_vel.out|g" $SETTINGS_FILE
-mkdir ${DUMPS}/vel
-sed -i -e "s|^DUMP_PATH .*|DUMP_PATH                        ${DUMPS}/vel/|g" $SETTINGS_FILE
+# all gauges in one run from one setup: res_velA.out, res_len.out, res_vel.out and
+# dumps in ${DUMPS}/velA, ${DUMPS}/len, ${DUMPS}/vel
+sed -i -e "s|^GAUGE .*|GAUGE                        velocity_with_Asqrt length velocity|g" $SETTINGS_FILE
+sed -i -e "s|^OUT_FILE .*|OUT_FILE                        res.out|g" $SETTINGS_FILE
+sed -i -e "s|^DUMP_PATH .*|DUMP_PATH                        ${DUMPS}/|g" $SETTINGS_FILE
 
-$PHOTO_TD_PATH./main $SETTINGS_FILE >$LOGS/log_td_vel.out
+$PHOTO_TD_PATH./main $SETTINGS_FILE >$LOGS/log_td.out
 
 if [ "$?" -ne 0 ]; then
-    echo " Velocity gauge computation (photo_td) failed."
+    echo " Propagation (photo_td) failed."
     exit 1
 fi
 
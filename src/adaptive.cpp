@@ -0,0 +1,80 @@
+#include "adaptive.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+using namespace Eigen;
+
+Step_controller::Step_controller(Time_propagator& propagator,
+                                 const MatrixXcd& S,
+                                 const Interaction& interaction,
+                                 const Control_data& control)
+    : _propagator(propagator),
+      _interaction(interaction),
+      _S(S),
+      _tolerance(control.adaptive_tol),
+      _dt(control.dt),
+      _min_dt(control.min_dt),
+      _max_dt(control.max_dt),
+      _h(control.dt) {
+    if (_tolerance <= 0.0)
+        throw runtime_error("Adaptive time stepping requires positive ADAPTIVE_TOLERANCE.");
+    if (!(_min_dt > 0.0 && _min_dt <= _dt && _dt <= _max_dt))
+        throw runtime_error("Adaptive time stepping requires 0 < MIN_DT <= DT <= MAX_DT.");
+}
+
+double Step_controller::pulse_cap(const double& time) const {
+    return _dt + (_max_dt - _dt) * (1.0 - _interaction.envelope(time));
+}
+
+double Step_controller::step(MatrixXcd& states, const double& time, const double& t_max) {
+    const int p = _propagator.order();
+
+    while (true) {
+        double h = min(_h, pulse_cap(time));
+        if (time < _interaction.pulse_end())
+            h = min(h, _interaction.pulse_end() - time);
+        h = min(h, t_max - time);
+
+        MatrixXcd coarse = states;
+        _propagator.step_block(coarse, time, h);
+        MatrixXcd fine = states;
+        _propagator.step_block(fine, time, h / 2.0);
+        _propagator.step_block(fine, time + h / 2.0, h / 2.0);
+
+        double err2 = 0.0;
+        for (Index k = 0; k < states.cols(); ++k) {
+            const VectorXcd diff = fine.col(k) - coarse.col(k);
+            err2 += diff.dot(_S * diff).real();
+        }
+        const double err  = sqrt(err2) / (pow(2.0, p) - 1.0);
+        const double fac  = err > 0.0 ? min(2.0, max(0.2, 0.9 * pow(_tolerance / err, 1.0 / (p + 1)))) : 2.0;
+        const bool forced = h <= _min_dt;
+
+        if (err <= _tolerance || forced) {
+            if (err > _tolerance)
+                ++_forced;
+            states = fine;
+            _h    = min(_max_dt, max(_min_dt, max(_h, h) * fac));
+
+            _smallest = _accepted == 0 ? h : min(_smallest, h);
+            _largest  = max(_largest, h);
+            ++_accepted;
+            return h;
+        }
+
+        _h = max(_min_dt, h * fac);
+        ++_rejected;
+    }
+}
+
+void Step_controller::print_statistics(ostream& os) const {
+    os << " Adaptive time stepping statistics:\n"
+       << "   accepted steps:           " << _accepted << '\n'
+       << "   rejected steps:           " << _rejected << '\n'
+       << "   accepted at MIN_DT:       " << _forced << '\n'
+       << "   smallest step:            " << _smallest << '\n'
+       << "   largest step:             " << _largest << "\n\n";
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <iostream>
+
+#include <eigen3/Eigen/Dense>
+
+#include "control_data.h"
+#include "interaction.h"
+#include "propagators.h"
+
+// Adaptive time stepping on top of any fixed-step propagator. The local error is estimated by
+// step doubling and kept below ADAPTIVE_TOLERANCE; on top of that the step is capped by
+// DT + (MAX_DT - DT) (1 - envelope(t)), so it shrinks near the field peaks and grows to MAX_DT
+// in field-free regions. Steps never cross the end of the pulse.
+class Step_controller {
+   public:
+    Step_controller(Time_propagator& propagator,
+                    const Eigen::MatrixXcd& S,
+                    const Interaction& interaction,
+                    const Control_data& control);
+
+    // advances the orbitals in the columns of states from time by one accepted step not
+    // exceeding t_max, returns its size; the error is measured over all of them
+    double step(Eigen::MatrixXcd& states, const double& time, const double& t_max);
+
+    // next trial step, kept in checkpoints
+    double step_size() const { return _h; }
+    void set_step_size(const double& h) { _h = h; }
+
+    void print_statistics(std::ostream& os) const;
+
+   private:
+    double pulse_cap(const double& time) const;
+
+    Time_propagator& _propagator;
+    const Interaction& _interaction;
+    const Eigen::MatrixXcd& _S;
+
+    const double _tolerance;
+    const double _dt;
+    const double _min_dt;
+    const double _max_dt;
+    double _h;
+
+    long _accepted{0};
+    long _rejected{0};
+    long _forced{0};
+    double _smallest{0.0};
+    double _largest{0.0};
+};
@@ -0,0 +1,129 @@
+#include "checkpoint.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace Eigen;
+
+namespace {
+
+struct Checkpoint_header {
+    char magic[8]{'P', 'T', 'D', 'C', 'H', 'K', 'P', 'T'};
+    std::uint32_t version{3};
+    std::uint32_t reserved{0};
+    std::uint64_t control_key{0};
+    std::uint64_t integrals_key{0};
+    std::int64_t step{0};
+    std::int64_t registered{0};
+    double time{0.0};
+    double step_size{0.0};
+    std::uint64_t state_size{0};
+    std::uint64_t results_size{0};
+    std::uint64_t dumps_count{0};
+};
+
+}  // namespace
+
+std::uint64_t control_hash(const Control_data& control) {
+    ostringstream echo;
+    echo << control;
+    const string text = echo.str();
+    return hash_bytes(text.data(), text.size());
+}
+
+std::uint64_t integrals_hash(const Integrals& ints, const MatrixXcd& U) {
+    std::uint64_t key = hash_bytes(nullptr, 0);
+    for (auto m : {&ints.S, &ints.H, &ints.Dx, &ints.Dy, &ints.Dz, &ints.Gx, &ints.Gy, &ints.Gz, &ints.CAP, &U})
+        key = hash_bytes(m->data(), m->size() * sizeof(complex<double>), key);
+    return key;
+}
+
+string checkpoint_path(const Control_data& control) {
+    return control.checkpoint_path + "/" + control.job_name + ".chk";
+}
+
+void save_checkpoint(const string& path,
+                     const std::uint64_t& control_key,
+                     const std::uint64_t& integrals_key,
+                     const Checkpoint& checkpoint) {
+    Checkpoint_header header;
+    header.control_key   = control_key;
+    header.integrals_key = integrals_key;
+    header.step          = checkpoint.step;
+    header.registered    = checkpoint.registered;
+    header.time          = checkpoint.time;
+    header.step_size     = checkpoint.step_size;
+    header.state_size    = checkpoint.state.size();
+    header.results_size  = checkpoint.results_size;
+    header.dumps_count   = checkpoint.dumps.size();
+
+    const string tmp_path = path + ".tmp";
+    ofstream file(tmp_path, ios::out | ios::binary | ios::trunc);
+    if (!file.is_open())
+        throw runtime_error("Cannot open checkpoint: " + tmp_path);
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(checkpoint.state.data()), checkpoint.state.size() * sizeof(complex<double>));
+    file.write(reinterpret_cast<const char*>(checkpoint.dumps.data()),
+               checkpoint.dumps.size() * sizeof(Dump_index_entry));
+    file.close();
+
+    if (!file)
+        throw runtime_error("Writing checkpoint failed: " + tmp_path);
+    if (rename(tmp_path.c_str(), path.c_str()) != 0)
+        throw runtime_error("Cannot rename checkpoint to " + path);
+}
+
+Checkpoint load_checkpoint(const string& path, const std::uint64_t& control_key, const std::uint64_t& integrals_key) {
+    ifstream file(path, ios::in | ios::binary);
+    if (!file.is_open())
+        throw runtime_error("Cannot open checkpoint: " + path);
+
+    Checkpoint_header header;
+    const Checkpoint_header reference;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || !equal(begin(reference.magic), end(reference.magic), begin(header.magic)) ||
+        header.version != reference.version)
+        throw runtime_error("Not a checkpoint of this version: " + path);
+    if (header.control_key != control_key)
+        throw runtime_error("Checkpoint was written with different settings: " + path);
+    if (header.integrals_key != integrals_key)
+        throw runtime_error("Checkpoint was written for different integrals: " + path);
+
+    Checkpoint checkpoint;
+    checkpoint.step         = header.step;
+    checkpoint.registered   = header.registered;
+    checkpoint.time         = header.time;
+    checkpoint.step_size    = header.step_size;
+    checkpoint.results_size = header.results_size;
+
+    checkpoint.state.resize(header.state_size);
+    file.read(reinterpret_cast<char*>(checkpoint.state.data()), checkpoint.state.size() * sizeof(complex<double>));
+
+    checkpoint.dumps.resize(header.dumps_count);
+    file.read(reinterpret_cast<char*>(checkpoint.dumps.data()), checkpoint.dumps.size() * sizeof(Dump_index_entry));
+
+    if (!file)
+        throw runtime_error("Checkpoint is truncated: " + path);
+    return checkpoint;
+}
+
+Checkpoint_policy::Checkpoint_policy(const Control_data& control)
+    : _enabled(!control.checkpoint_path.empty() &&
+               (control.checkpoint_interval > 0 || control.checkpoint_wall_time > 0.0)),
+      _interval(control.checkpoint_interval),
+      _wall_time(control.checkpoint_wall_time) {}
+
+bool Checkpoint_policy::due(const std::int64_t& step) {
+    if (!_enabled)
+        return false;
+
+    const bool due = (_interval > 0 && step % _interval == 0) ||
+                     (_wall_time > 0.0 && _clock.duration().count() >= _wall_time);
+    if (due)
+        _clock.restart();
+    return due;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <eigen3/Eigen/Dense>
+
+#include "control_data.h"
+#include "dump_codec.h"
+#include "procedures.h"
+#include "utils.h"
+
+// Everything needed to continue the time propagation after step: the reduced-basis state, the
+// size of the results file and the index of the binary dump up to this point.
+struct Checkpoint {
+    std::int64_t step{0};        // last completed step
+    std::int64_t registered{0};  // next REGISTER_DIPOLE_DT point, adaptive stepping only
+    double time{0.0};
+    double step_size{0.0};  // next trial step of the step controller, adaptive stepping only
+    Eigen::VectorXcd state{};
+    std::uint64_t results_size{0};
+    std::vector<Dump_index_entry> dumps{};
+};
+
+// hash of the parameters echoed into the results file, a restart must use the same ones
+std::uint64_t control_hash(const Control_data& control);
+// hash of the operators and U the propagation runs with
+std::uint64_t integrals_hash(const Integrals& ints, const Eigen::MatrixXcd& U);
+
+// CHECKPOINT_PATH/<JOB_NAME>.chk
+std::string checkpoint_path(const Control_data& control);
+
+// written to a temporary file and renamed, so an interrupted write never replaces a good checkpoint
+void save_checkpoint(const std::string& path,
+                     const std::uint64_t& control_key,
+                     const std::uint64_t& integrals_key,
+                     const Checkpoint& checkpoint);
+
+// throws if the checkpoint was written for other parameters or integrals
+Checkpoint load_checkpoint(const std::string& path,
+                           const std::uint64_t& control_key,
+                           const std::uint64_t& integrals_key);
+
+// A checkpoint is due every CHECKPOINT_INTERVAL steps and when CHECKPOINT_WALL_TIME seconds
+// have passed since the last one; zero disables either criterion.
+class Checkpoint_policy {
+   public:
+    explicit Checkpoint_policy(const Control_data& control);
+
+    bool enabled() const { return _enabled; }
+    bool due(const std::int64_t& step);
+
+   private:
+    const bool _enabled;
+    const int _interval;
+    const double _wall_time;
+    Clock _clock{};
+};
@@ -1,6 +1,9 @@
 #include "control_data.h"
 
+#include <algorithm>
+#include <cmath>
 #include <regex>
+#include <sstream>
 
 Control_data Control_data::parse_input_file(const std::string &input_file,
                                             const std::string &start_token,
@@ -36,43 +39,123 @@ Control_data Control_data::parse_input_file(const std::string &input_file,
             val = std::stod(search->second.at(0));
     };
 
+    auto set_unique_int = [&](const std::string &key, int &val) {
+        const auto search = keys.find(key);
+        if (search != keys.end())
+            val = std::stoi(search->second.at(0));
+    };
+
     set_unique_string("JOB_NAME", cd.job_name);
     set_unique_string("RESOURCES_PATH", cd.resources_path);
     set_unique_string("FILE_1E", cd.file1E);
     set_unique_string("OUT_FILE", cd.out_file);
     set_unique_string("OUT_PATH", cd.out_path);
     set_unique_string("DUMP_PATH", cd.dump_path);
+    set_unique_string("CACHE_PATH", cd.cache_path);
+    set_unique_string("CHECKPOINT_PATH", cd.checkpoint_path);
 
     set_unique_bool("WRITE", cd.write);
     set_unique_bool("USE_CAP", cd.use_cap);
     set_unique_bool("DUMP", cd.dump);
+    set_unique_bool("VELOCITY_DIPOLE", cd.velocity_dipole);
+    set_unique_bool("ANALYTIC_FIELD_FREE", cd.analytic_field_free);
+    set_unique_bool("ADAPTIVE_DT", cd.adaptive_dt);
+    set_unique_bool("SPECTRAL_BASIS", cd.spectral_basis);
+
+    // a list of values or ranges start:stop:count, with :log for geometric spacing; with more
+    // than one value the key is swept and val is the first value
+    auto set_sweep_double = [&](const std::string &key, double &val, std::vector<double> &list) {
+        const auto search = keys.find(key);
+        if (search == keys.end())
+            return;
+
+        std::vector<double> values;
+        for (const auto &token : search->second) {
+            std::vector<std::string> fields;
+            std::stringstream stream(token);
+            for (std::string field; std::getline(stream, field, ':');)
+                fields.push_back(field);
+
+            if (fields.size() == 1) {
+                values.push_back(std::stod(token));
+                continue;
+            }
+            if (fields.size() < 3 || fields.size() > 4 || (fields.size() == 4 && fields[3] != "log"))
+                throw std::runtime_error("Range of " + key + " is not start:stop:count[:log]: " + token);
 
-    set_unique_double("OPT_INTENSITY", cd.opt_intensity);
-    set_unique_double("OPT_OMEGA_EV", cd.opt_omega_eV);
-    set_unique_double("OPT_CARRIER_ENVELOPE", cd.opt_carrier_envelope);
-    set_unique_double("OPT_CYCLES", cd.opt_cycles);
+            const double start = std::stod(fields[0]);
+            const double stop  = std::stod(fields[1]);
+            const int count    = std::stoi(fields[2]);
+            const bool log     = fields.size() == 4;
+            if (count < 1)
+                throw std::runtime_error("Range of " + key + " needs at least one value: " + token);
+            if (log && (start <= 0.0 || stop <= 0.0))
+                throw std::runtime_error("Logarithmic range of " + key + " needs positive bounds: " + token);
+
+            for (int i = 0; i < count; ++i) {
+                const double x = count == 1 ? 0.0 : static_cast<double>(i) / (count - 1);
+                values.push_back(log ? start * std::pow(stop / start, x) : start + (stop - start) * x);
+            }
+        }
+
+        val = values.at(0);
+        if (values.size() > 1)
+            list = values;
+    };
+
+    set_sweep_double("OPT_INTENSITY", cd.opt_intensity, cd.sweep.intensity);
+    set_sweep_double("OPT_OMEGA_EV", cd.opt_omega_eV, cd.sweep.omega_eV);
+    set_sweep_double("OPT_CARRIER_ENVELOPE", cd.opt_carrier_envelope, cd.sweep.carrier_envelope);
+    set_sweep_double("OPT_CYCLES", cd.opt_cycles, cd.sweep.cycles);
+    set_unique_int("ORIENTATIONS", cd.orientations);
 
     set_unique_double("DT", cd.dt);
     set_unique_double("MAX_T", cd.max_t);
     set_unique_double("REGISTER_DIPOLE_DT", cd.register_dip);
 
+    set_unique_double("PROPAGATOR_TOLERANCE", cd.propagator_tol);
+    set_unique_int("KRYLOV_DIM", cd.krylov_dim);
+    set_unique_int("BATCH_SIZE", cd.batch_size);
+    set_unique_double("SPECTRAL_CUTOFF_EV", cd.spectral_cutoff_eV);
+    set_unique_int("EIGENSTATES", cd.eigenstates);
+    set_unique_int("INITIAL_STATE", cd.initial_state);
+    set_unique_int("ORBITALS", cd.orbitals);
+    set_unique_double("EIGENSOLVER_TOLERANCE", cd.eigensolver_tol);
+    set_unique_double("ADAPTIVE_TOLERANCE", cd.adaptive_tol);
+    set_unique_double("MIN_DT", cd.min_dt);
+    set_unique_double("MAX_DT", cd.max_dt);
+
+    set_unique_double("DUMP_TOLERANCE", cd.dump_tolerance);
+    set_unique_int("CHECKPOINT_INTERVAL", cd.checkpoint_interval);
+    set_unique_double("CHECKPOINT_WALL_TIME", cd.checkpoint_wall_time);
+
     set_unique_double("CAP_R0", cd.cap_r0);
     set_unique_double("CAP_AMPLITUDE", cd.cap_amp);
 
     {
         const auto search = keys.find("GAUGE");
         if (search != keys.end()) {
-            std::string gauge = search->second.at(0);
-            std::transform(gauge.begin(), gauge.end(), gauge.begin(), ::tolower);
+            cd.gauges.clear();
+            for (std::string gauge : search->second) {
+                std::transform(gauge.begin(), gauge.end(), gauge.begin(), ::tolower);
+
+                if (gauge == "length")
+                    cd.gauges.push_back(Gauge::length);
+                else if (gauge == "velocity")
+                    cd.gauges.push_back(Gauge::velocity);
+                else if (gauge == "acceleration")
+                    cd.gauges.push_back(Gauge::acceleration);
+                else if (gauge == "velocity_with_asqrt")
+                    cd.gauges.push_back(Gauge::velocity_with_Asqrt);
+                else
+                    throw std::runtime_error("Unknown gauge: " + gauge);
 
-            if (gauge == "length")
-                cd.gauge = Gauge::length;
-            else if (gauge == "velocity")
-                cd.gauge = Gauge::velocity;
-            else if (gauge == "acceleration")
-                cd.gauge = Gauge::acceleration;
-            else if (gauge == "velocity_with_asqrt")
-                cd.gauge = Gauge::velocity_with_Asqrt;
+                if (std::count(cd.gauges.begin(), cd.gauges.end(), cd.gauges.back()) > 1)
+                    throw std::runtime_error("GAUGE lists " + gauge + " twice.");
+            }
+            if (cd.gauges.empty())
+                throw std::runtime_error("GAUGE needs at least one gauge.");
+            cd.gauge = cd.gauges.front();
         }
     }
     {
@@ -87,12 +170,134 @@ Control_data Control_data::parse_input_file(const std::string &input_file,
                 cd.representation = Representation::spherical;
         }
     }
+    {
+        const auto search = keys.find("INTEGRALS_FORMAT");
+        if (search != keys.end()) {
+            std::string format = search->second.at(0);
+            std::transform(format.begin(), format.end(), format.begin(), ::tolower);
+
+            if (format == "xgtopw")
+                cd.integrals_format = Integrals_format::xgtopw;
+            else if (format == "native")
+                cd.integrals_format = Integrals_format::native;
+            else
+                throw std::runtime_error("Unknown integrals format: " + format);
+        }
+    }
+    {
+        const auto search = keys.find("RESULTS_FORMAT");
+        if (search != keys.end()) {
+            std::string format = search->second.at(0);
+            std::transform(format.begin(), format.end(), format.begin(), ::tolower);
+
+            if (format == "text")
+                cd.results_format = Results_format::text;
+            else if (format == "binary")
+                cd.results_format = Results_format::binary;
+            else
+                throw std::runtime_error("Unknown results format: " + format);
+        }
+    }
+    {
+        const auto search = keys.find("DUMP_FORMAT");
+        if (search != keys.end()) {
+            std::string format = search->second.at(0);
+            std::transform(format.begin(), format.end(), format.begin(), ::tolower);
+
+            if (format == "binary")
+                cd.dump_format = Dump_format::binary;
+            else if (format == "text")
+                cd.dump_format = Dump_format::text;
+            else
+                throw std::runtime_error("Unknown dump format: " + format);
+        }
+    }
+    {
+        const auto search = keys.find("DUMP_PRECISION");
+        if (search != keys.end()) {
+            std::string precision = search->second.at(0);
+            std::transform(precision.begin(), precision.end(), precision.begin(), ::tolower);
+
+            if (precision == "double")
+                cd.dump_precision = Dump_precision::full;
+            else if (precision == "float")
+                cd.dump_precision = Dump_precision::single;
+            else if (precision == "quantized")
+                cd.dump_precision = Dump_precision::quantized;
+            else
+                throw std::runtime_error("Unknown dump precision: " + precision);
+        }
+    }
+    {
+        const auto search = keys.find("PROPAGATOR");
+        if (search != keys.end()) {
+            std::string prop = search->second.at(0);
+            std::transform(prop.begin(), prop.end(), prop.begin(), ::tolower);
+
+            if (prop == "crank_nicolson")
+                cd.propagator = Propagator::crank_nicolson;
+            else if (prop == "crank_nicolson_pencil")
+                cd.propagator = Propagator::crank_nicolson_pencil;
+            else if (prop == "rk4")
+                cd.propagator = Propagator::rk4;
+            else if (prop == "rk45")
+                cd.propagator = Propagator::rk45;
+            else if (prop == "short_iterative_arnoldi")
+                cd.propagator = Propagator::short_iterative_arnoldi;
+            else if (prop == "krylov")
+                cd.propagator = Propagator::krylov;
+            else if (prop == "interaction_picture")
+                cd.propagator = Propagator::interaction_picture;
+            else if (prop == "cfet4")
+                cd.propagator = Propagator::cfet4;
+            else if (prop == "cfet6")
+                cd.propagator = Propagator::cfet6;
+            else
+                throw std::runtime_error("Unknown propagator: " + prop);
+        }
+    }
+    {
+        const auto search = keys.find("EXPONENTIAL");
+        if (search != keys.end()) {
+            std::string exp = search->second.at(0);
+            std::transform(exp.begin(), exp.end(), exp.begin(), ::tolower);
+
+            if (exp == "pade")
+                cd.exponential = Exponential::pade;
+            else if (exp == "krylov")
+                cd.exponential = Exponential::krylov;
+            else
+                throw std::runtime_error("Unknown exponential backend: " + exp);
+        }
+    }
+    {
+        const auto search = keys.find("EIGENSOLVER");
+        if (search != keys.end()) {
+            std::string solver = search->second.at(0);
+            std::transform(solver.begin(), solver.end(), solver.begin(), ::tolower);
+
+            if (solver == "dense")
+                cd.eigensolver = Eigensolver::dense;
+            else if (solver == "davidson")
+                cd.eigensolver = Eigensolver::davidson;
+            else
+                throw std::runtime_error("Unknown eigensolver: " + solver);
+        }
+    }
     {
         const auto search = keys.find("OPT_FIELD_DIRECTION");
         if (search != keys.end()) {
-            cd.opt_fielddir(0) = std::stod(search->second.at(0));
-            cd.opt_fielddir(1) = std::stod(search->second.at(1));
-            cd.opt_fielddir(2) = std::stod(search->second.at(2));
+            // several directions are given as consecutive triples
+            const auto &tokens = search->second;
+            if (tokens.empty() || tokens.size() % 3 != 0)
+                throw std::runtime_error("OPT_FIELD_DIRECTION needs three components per direction.");
+
+            for (std::size_t i = 0; i < tokens.size(); i += 3)
+                cd.sweep.field_direction.emplace_back(std::stod(tokens[i]), std::stod(tokens[i + 1]),
+                                                      std::stod(tokens[i + 2]));
+            cd.opt_fielddir = cd.sweep.field_direction.front();
+            if (cd.sweep.field_direction.size() == 1)
+                cd.sweep.field_direction.clear();
         }
     }
 
@@ -138,14 +343,25 @@ std::ostream &operator<<(std::ostream &os, const Control_data &rhs) {
     os << "# ==============================================================================\n";
     os << "# JOB_NAME                        " << rhs.job_name << '\n';
     os << "# ==============================================================================\n";
-    os << "# GAUGE                           " << rhs.gauge << '\n';
+    os << "# GAUGE                          ";
+    for (const auto& gauge : rhs.gauges)
+        os << ' ' << gauge;
+    os << '\n';
     os << "# REPRESENTATION                  " << rhs.representation << '\n';
+    os << "# INTEGRALS_FORMAT                " << rhs.integrals_format << '\n';
+    os << "# RESULTS_FORMAT                  " << rhs.results_format << '\n';
+    os << "# PROPAGATOR                      " << rhs.propagator << '\n';
+    if (rhs.propagator == Propagator::cfet4 || rhs.propagator == Propagator::cfet6)
+        os << "# EXPONENTIAL                     " << rhs.exponential << '\n';
+    os << "# EIGENSOLVER                     " << rhs.eigensolver << '\n';
     os << "# ==============================================================================\n";
     os << "# OPT_INTENSITY                   " << rhs.opt_intensity << '\n';
     os << "# OPT_FIELD_DIRECTION             " << rhs.opt_fielddir.transpose() << '\n';
     os << "# OPT_OMEGA_EV                    " << rhs.opt_omega_eV << '\n';
     os << "# OPT_CARRIER_ENVELOPE            " << rhs.opt_carrier_envelope << '\n';
     os << "# OPT_CYCLES                      " << rhs.opt_cycles << '\n';
+    if (rhs.orientations > 0)
+        os << "# ORIENTATIONS                    " << rhs.orientations << '\n';
     os << "# ==============================================================================\n";
     os << "# USE_CAP                         " << (rhs.use_cap ? 'Y' : 'N') << '\n';
     os << "# CAP_R0                          " << rhs.cap_r0 << '\n';
@@ -154,6 +370,28 @@ std::ostream &operator<<(std::ostream &os, const Control_data &rhs) {
     os << "# DT                              " << rhs.dt << '\n';
     os << "# MAX_T                           " << rhs.max_t << '\n';
     os << "# REGISTER_DIPOLE_DT              " << rhs.register_dip << '\n';
+    os << "# VELOCITY_DIPOLE                 " << (rhs.velocity_dipole ? 'Y' : 'N') << '\n';
+    os << "# PROPAGATOR_TOLERANCE            " << rhs.propagator_tol << '\n';
+    os << "# KRYLOV_DIM                      " << rhs.krylov_dim << '\n';
+    if (rhs.batch_size > 1)
+        os << "# BATCH_SIZE                      " << rhs.batch_size << '\n';
+    os << "# INITIAL_STATE                   " << rhs.initial_state << '\n';
+    if (rhs.orbitals > 1)
+        os << "# ORBITALS                        " << rhs.orbitals << '\n';
+    if (rhs.eigensolver == Eigensolver::davidson) {
+        os << "# EIGENSTATES                     " << rhs.eigenstates << '\n';
+        os << "# EIGENSOLVER_TOLERANCE           " << rhs.eigensolver_tol << '\n';
+    }
+    os << "# SPECTRAL_BASIS                  " << (rhs.spectral_basis ? 'Y' : 'N') << '\n';
+    if (rhs.spectral_basis)
+        os << "# SPECTRAL_CUTOFF_EV              " << rhs.spectral_cutoff_eV << '\n';
+    os << "# ANALYTIC_FIELD_FREE             " << (rhs.analytic_field_free ? 'Y' : 'N') << '\n';
+    os << "# ADAPTIVE_DT                     " << (rhs.adaptive_dt ? 'Y' : 'N') << '\n';
+    if (rhs.adaptive_dt) {
+        os << "# ADAPTIVE_TOLERANCE              " << rhs.adaptive_tol << '\n';
+        os << "# MIN_DT                          " << rhs.min_dt << '\n';
+        os << "# MAX_DT                          " << rhs.max_dt << '\n';
+    }
     os << "# ==============================================================================\n";
     return os;
 }
@@ -191,3 +429,125 @@ std::ostream &operator<<(std::ostream &os, const Representation &rhs) {
     }
     return os;
 }
+
+std::ostream &operator<<(std::ostream &os, const Integrals_format &rhs) {
+    switch (rhs) {
+        case Integrals_format::xgtopw:
+            os << "xgtopw";
+            return os;
+        case Integrals_format::native:
+            os << "native";
+            return os;
+        default:
+            assert(true);
+    }
+    return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const Results_format &rhs) {
+    switch (rhs) {
+        case Results_format::text:
+            os << "text";
+            return os;
+        case Results_format::binary:
+            os << "binary";
+            return os;
+        default:
+            assert(true);
+    }
+    return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const Dump_format &rhs) {
+    switch (rhs) {
+        case Dump_format::binary:
+            os << "binary";
+            return os;
+        case Dump_format::text:
+            os << "text";
+            return os;
+        default:
+            assert(true);
+    }
+    return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const Dump_precision &rhs) {
+    switch (rhs) {
+        case Dump_precision::full:
+            os << "double";
+            return os;
+        case Dump_precision::single:
+            os << "float";
+            return os;
+        case Dump_precision::quantized:
+            os << "quantized";
+            return os;
+        default:
+            assert(true);
+    }
+    return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const Propagator &rhs) {
+    switch (rhs) {
+        case Propagator::crank_nicolson:
+            os << "crank_nicolson";
+            return os;
+        case Propagator::crank_nicolson_pencil:
+            os << "crank_nicolson_pencil";
+            return os;
+        case Propagator::rk4:
+            os << "rk4";
+            return os;
+        case Propagator::rk45:
+            os << "rk45";
+            return os;
+        case Propagator::short_iterative_arnoldi:
+            os << "short_iterative_arnoldi";
+            return os;
+        case Propagator::krylov:
+            os << "krylov";
+            return os;
+        case Propagator::interaction_picture:
+            os << "interaction_picture";
+            return os;
+        case Propagator::cfet4:
+            os << "cfet4";
+            return os;
+        case Propagator::cfet6:
+            os << "cfet6";
+            return os;
+        default:
+            assert(true);
+    }
+    return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const Exponential &rhs) {
+    switch (rhs) {
+        case Exponential::pade:
+            os << "pade";
+            return os;
+        case Exponential::krylov:
+            os << "krylov";
+            return os;
+        default:
+            assert(true);
+    }
+    return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const Eigensolver &rhs) {
+    switch (rhs) {
+        case Eigensolver::dense:
+            os << "dense";
+            return os;
+        case Eigensolver::davidson:
+            os << "davidson";
+            return os;
+        default:
+            assert(true);
+    }
+    return os;
+}
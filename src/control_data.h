@@ -26,25 +26,114 @@ enum class Representation {
 
 std::ostream &operator<<(std::ostream &os, const Representation &rhs);
 
+enum class Integrals_format {
+    xgtopw,
+    native
+};
+
+std::ostream &operator<<(std::ostream &os, const Integrals_format &rhs);
+
+enum class Results_format {
+    text,
+    binary
+};
+
+std::ostream &operator<<(std::ostream &os, const Results_format &rhs);
+
+enum class Dump_format {
+    binary,
+    text
+};
+
+std::ostream &operator<<(std::ostream &os, const Dump_format &rhs);
+
+enum class Dump_precision {
+    full,
+    single,
+    quantized
+};
+
+std::ostream &operator<<(std::ostream &os, const Dump_precision &rhs);
+
+enum class Propagator {
+    crank_nicolson,
+    crank_nicolson_pencil,
+    rk4,
+    rk45,
+    short_iterative_arnoldi,
+    krylov,
+    interaction_picture,
+    cfet4,
+    cfet6
+};
+
+std::ostream &operator<<(std::ostream &os, const Propagator &rhs);
+
+enum class Exponential {
+    pade,
+    krylov
+};
+
+std::ostream &operator<<(std::ostream &os, const Exponential &rhs);
+
+enum class Eigensolver {
+    dense,
+    davidson
+};
+
+std::ostream &operator<<(std::ostream &os, const Eigensolver &rhs);
+
+// Lists of laser parameters scanned in one run, from OPT_* keys with more than one value. An
+// empty list keeps the single value of Control_data; the sweep is the product of all lists.
+struct Sweep {
+    std::vector<double> intensity{};
+    std::vector<double> omega_eV{};
+    std::vector<double> carrier_envelope{};
+    std::vector<double> cycles{};
+    std::vector<Eigen::Vector3d> field_direction{};
+
+    bool empty() const {
+        return intensity.empty() && omega_eV.empty() && carrier_envelope.empty() && cycles.empty() &&
+               field_direction.empty();
+    }
+};
+
 class Control_data {
    public:
     std::string job_name{"job"};
     std::string resources_path{};
     std::string file1E{};
+    Integrals_format integrals_format{Integrals_format::xgtopw};
     bool write{true};
     std::string out_path{};
     std::string out_file{"res.out"};
+    Results_format results_format{Results_format::text};
     bool dump{false};
     std::string dump_path{};
+    Dump_format dump_format{Dump_format::binary};
+    Dump_precision dump_precision{Dump_precision::full};
+    double dump_tolerance{1.0e-8};
+    std::string cache_path{};
+    std::string checkpoint_path{};
+    int checkpoint_interval{0};
+    double checkpoint_wall_time{0.0};
 
     Gauge gauge{Gauge::length};
+    // all gauges of GAUGE, propagated concurrently from one setup; gauge is the first of them
+    std::vector<Gauge> gauges{Gauge::length};
     Representation representation{Representation::cartesian};
+    Propagator propagator{Propagator::crank_nicolson};
+    Exponential exponential{Exponential::krylov};
+    Eigensolver eigensolver{Eigensolver::dense};
 
     double opt_intensity{1.0e14};  //W/cm^2
     Eigen::Vector3d opt_fielddir{0.0, 0.0, 1.0};
     double opt_omega_eV{1.55};
     double opt_carrier_envelope{0.0};
     double opt_cycles{4.0};
+    Sweep sweep{};
+    // Lebedev grid of field directions for orientation averaging, 0 for a single direction
+    int orientations{0};
 
     bool use_cap{false};
     double cap_r0{40.0};
@@ -53,6 +142,28 @@ class Control_data {
     double dt{0.01};
     double max_t{1000};
     double register_dip{1.0};
+    bool velocity_dipole{false};
+
+    double propagator_tol{1.0e-8};
+    int krylov_dim{12};
+    // sweep points of one gauge propagated together as columns of one state matrix
+    int batch_size{1};
+
+    int eigenstates{1};
+    int initial_state{0};
+    // eigenstates INITIAL_STATE .. INITIAL_STATE + ORBITALS - 1 propagated together as one block
+    int orbitals{1};
+    double eigensolver_tol{1.0e-10};
+
+    bool analytic_field_free{false};
+
+    bool spectral_basis{false};
+    double spectral_cutoff_eV{std::numeric_limits<double>::infinity()};
+
+    bool adaptive_dt{false};
+    double adaptive_tol{1.0e-6};
+    double min_dt{1.0e-4};
+    double max_dt{1.0};
 
     Basis basis{};
 
@@ -1,80 +1,101 @@
 #include "disk_reader.h"
 
-#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cmath>
 #include <complex>
-#include <fstream>
 #include <stdexcept>
-#include <vector>
 
-Disk_reader::Disk_reader(const int &basis_length, const std::string &path)
-    : _basis_l(basis_length), _path(path) {}
+using namespace std::complex_literals;
 
-Eigen::MatrixXcd Disk_reader::load_matrix1E_bin(const int &position) const {
-    std::ifstream file1E(_path, std::ios::in | std::ios::binary | std::ios::ate);
-    if (!file1E.is_open())
+Disk_reader::Disk_reader(const int &basis_length, const std::string &path)
+    : _basis_l(basis_length), _path(path) {
+    const int fd = open(_path.c_str(), O_RDONLY);
+    if (fd < 0)
         throw std::runtime_error("Unable to open 1E file.");
 
-    const auto bl_sqrt = _basis_l * _basis_l;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Unable to stat 1E file.");
+    }
+    _size = st.st_size;
 
-    const auto size1E      = file1E.tellg();
-    const int complex_size = size1E * sizeof(char) / sizeof(double) / 2;
+    const std::size_t bl_sqrt      = static_cast<std::size_t>(_basis_l) * _basis_l;
+    const std::size_t complex_size = _size / sizeof(double) / 2;
 
-    if (complex_size != bl_sqrt * _matrices1E_number)
+    if (complex_size != bl_sqrt * matrices1E_number) {
+        close(fd);
         throw std::runtime_error("The size of 1E file does not match the basis size ( " + std::to_string(_basis_l) + " )." +
-                                 "Have you used the correct 1E file? its size correspond to basis size " + std::to_string(std::sqrt(complex_size / _matrices1E_number)));
+                                 "Have you used the correct 1E file? its size correspond to basis size " + std::to_string(std::sqrt(complex_size / matrices1E_number)));
+    }
+
+    void *map = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        throw std::runtime_error("Unable to map 1E file.");
+    madvise(map, _size, MADV_SEQUENTIAL);
+
+    _data = static_cast<const double *>(map);
+}
 
-    std::vector<double> real(bl_sqrt);
-    std::vector<double> imag(bl_sqrt);
+Disk_reader::~Disk_reader() {
+    if (_data)
+        munmap(const_cast<double *>(_data), _size);
+}
 
-    const int chunk_size = size1E / _matrices1E_number / 2;
+Disk_reader::Plane Disk_reader::real_plane(const int &position) const {
+    const std::size_t bl_sqrt = static_cast<std::size_t>(_basis_l) * _basis_l;
+    return Plane(_data + 2 * position * bl_sqrt, _basis_l, _basis_l);
+}
 
-    file1E.seekg(2 * position * chunk_size, std::ios::beg);
-    file1E.read(reinterpret_cast<char *>(real.data()), chunk_size);
-    file1E.read(reinterpret_cast<char *>(imag.data()), chunk_size);
-    file1E.close();
+Disk_reader::Plane Disk_reader::imag_plane(const int &position) const {
+    const std::size_t bl_sqrt = static_cast<std::size_t>(_basis_l) * _basis_l;
+    return Plane(_data + (2 * position + 1) * bl_sqrt, _basis_l, _basis_l);
+}
 
+Eigen::MatrixXcd Disk_reader::load_matrix1E_bin(const int &position) const {
     Eigen::MatrixXcd ints(_basis_l, _basis_l);
-
-    assert(real.size() == imag.size());
-    std::transform(real.begin(), real.end(), imag.begin(), ints.data(),
-                   [](double &dr, double &di) {
-                       return std::complex<double>(dr, di);
-                   });
-    return ints.transpose();
+    ints.real() = real_plane(position);
+    ints.imag() = imag_plane(position);
+    return ints;
 }
 
-Eigen::MatrixXcd Disk_reader::load_S() const {
-    return load_matrix1E_bin(0);
+Eigen::MatrixXcd Integrals_reader::load_S() const {
+    return load_matrix1E_bin(S_slot);
 }
 
-Eigen::MatrixXcd Disk_reader::load_H() const {
-    return load_matrix1E_bin(3);
+Eigen::MatrixXcd Integrals_reader::load_H() const {
+    return load_matrix1E_bin(H_slot);
 }
 
-Eigen::MatrixXcd Disk_reader::load_Dipx() const {
-    return load_matrix1E_bin(4);
+Eigen::MatrixXcd Integrals_reader::load_Dipx() const {
+    return load_matrix1E_bin(Dipx_slot);
 }
 
-Eigen::MatrixXcd Disk_reader::load_Dipy() const {
-    return load_matrix1E_bin(5);
+Eigen::MatrixXcd Integrals_reader::load_Dipy() const {
+    return load_matrix1E_bin(Dipy_slot);
 }
 
-Eigen::MatrixXcd Disk_reader::load_Dipz() const {
-    return load_matrix1E_bin(6);
+Eigen::MatrixXcd Integrals_reader::load_Dipz() const {
+    return load_matrix1E_bin(Dipz_slot);
 }
 
-Eigen::MatrixXcd Disk_reader::load_Gradx() const {
-    return load_matrix1E_bin(13);
+Eigen::MatrixXcd Integrals_reader::load_Gradx() const {
+    return load_matrix1E_bin(Gradx_slot);
 }
 
-Eigen::MatrixXcd Disk_reader::load_Grady() const {
-    return load_matrix1E_bin(14);
+Eigen::MatrixXcd Integrals_reader::load_Grady() const {
+    return load_matrix1E_bin(Grady_slot);
 }
 
-Eigen::MatrixXcd Disk_reader::load_Gradz() const {
-    return load_matrix1E_bin(15);
+Eigen::MatrixXcd Integrals_reader::load_Gradz() const {
+    return load_matrix1E_bin(Gradz_slot);
 }
 
-Eigen::MatrixXcd Disk_reader::load_CAP() const {
-    return -1i * load_matrix1E_bin(19);
+Eigen::MatrixXcd Integrals_reader::load_CAP() const {
+    return -1i * load_matrix1E_bin(CAP_slot);
 }
@@ -1,12 +1,14 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 #include <eigen3/Eigen/Dense>
 
-class Disk_reader {
+// Source of the one-electron matrices, addressed by their xgtopw slot
+class Integrals_reader {
    public:
-    Disk_reader(const int &basis_length, const std::string &path);
+    virtual ~Integrals_reader() = default;
 
     Eigen::MatrixXcd load_S() const;
     Eigen::MatrixXcd load_H() const;
@@ -18,11 +20,45 @@ class Disk_reader {
     Eigen::MatrixXcd load_Gradz() const;
     Eigen::MatrixXcd load_CAP() const;
 
+    static constexpr int S_slot     = 0;
+    static constexpr int H_slot     = 3;
+    static constexpr int Dipx_slot  = 4;
+    static constexpr int Dipy_slot  = 5;
+    static constexpr int Dipz_slot  = 6;
+    static constexpr int Gradx_slot = 13;
+    static constexpr int Grady_slot = 14;
+    static constexpr int Gradz_slot = 15;
+    static constexpr int CAP_slot   = 19;
+
+   protected:
+    virtual Eigen::MatrixXcd load_matrix1E_bin(const int &position) const = 0;
+};
+
+// Read-only view of the xgtopw 1E file. The file is opened, validated and memory mapped once;
+// every slot holds row-major real and imaginary planes that are exposed as zero-copy maps and
+// materialized into a complex matrix only when the corresponding load_* is called.
+class Disk_reader : public Integrals_reader {
+   public:
+    using Plane = Eigen::Map<const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>;
+
+    Disk_reader(const int &basis_length, const std::string &path);
+    ~Disk_reader();
+
+    Disk_reader(const Disk_reader &) = delete;
+    Disk_reader &operator=(const Disk_reader &) = delete;
+
+    Plane real_plane(const int &position) const;
+    Plane imag_plane(const int &position) const;
+
+    static constexpr int matrices1E_number = 20;
+
    protected:
-    Eigen::MatrixXcd load_matrix1E_bin(const int &position) const;
+    Eigen::MatrixXcd load_matrix1E_bin(const int &position) const override;
 
    private:
-    static constexpr int _matrices1E_number = 20;
     const int _basis_l;
     const std::string _path;
-};
\ No newline at end of file
+
+    const double *_data{nullptr};
+    std::size_t _size{0};
+};
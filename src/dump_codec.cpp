@@ -0,0 +1,296 @@
+#include "dump_codec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+using namespace Eigen;
+
+namespace {
+
+constexpr size_t lz_min_match  = 4;
+constexpr size_t lz_max_offset = 65535;
+constexpr int lz_hash_bits     = 14;
+
+inline uint32_t read32(const unsigned char* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t lz_hash(const uint32_t& v) {
+    return (v * 2654435761u) >> (32 - lz_hash_bits);
+}
+
+void write_length(vector<unsigned char>& out, size_t length) {
+    for (; length >= 255; length -= 255)
+        out.push_back(255);
+    out.push_back(static_cast<unsigned char>(length));
+}
+
+size_t read_length(const unsigned char*& ip, const unsigned char* end) {
+    size_t length = 0;
+    unsigned char byte;
+    do {
+        if (ip >= end)
+            throw runtime_error("Corrupted LZ block.");
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return length;
+}
+
+void emit_sequence(vector<unsigned char>& out,
+                   const unsigned char* literals,
+                   const size_t& literal_length,
+                   const size_t& offset,
+                   const size_t& match_length) {
+    const size_t match_code = match_length ? match_length - lz_min_match : 0;
+    out.push_back(static_cast<unsigned char>((min<size_t>(literal_length, 15) << 4) | min<size_t>(match_code, 15)));
+    if (literal_length >= 15)
+        write_length(out, literal_length - 15);
+    out.insert(out.end(), literals, literals + literal_length);
+
+    if (match_length) {
+        out.push_back(static_cast<unsigned char>(offset & 0xff));
+        out.push_back(static_cast<unsigned char>(offset >> 8));
+        if (match_code >= 15)
+            write_length(out, match_code - 15);
+    }
+}
+
+}  // namespace
+
+vector<unsigned char> lz_compress(const unsigned char* src, const size_t& size) {
+    vector<unsigned char> out;
+    out.reserve(size / 2 + 16);
+
+    vector<int64_t> table(size_t(1) << lz_hash_bits, -1);
+    size_t anchor = 0;
+    size_t i      = 0;
+    while (i + lz_min_match <= size) {
+        const uint32_t word = read32(src + i);
+        const uint32_t h    = lz_hash(word);
+        const int64_t cand  = table[h];
+        table[h]            = i;
+
+        if (cand >= 0 && i - cand <= lz_max_offset && read32(src + cand) == word) {
+            size_t length = lz_min_match;
+            while (i + length < size && src[cand + length] == src[i + length])
+                ++length;
+
+            emit_sequence(out, src + anchor, i - anchor, i - cand, length);
+            i += length;
+            anchor = i;
+        } else {
+            ++i;
+        }
+    }
+    emit_sequence(out, src + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+void lz_decompress(const unsigned char* src, const size_t& size, unsigned char* dst, const size_t& dst_size) {
+    const unsigned char* ip  = src;
+    const unsigned char* end = src + size;
+    size_t op                = 0;
+
+    while (ip < end) {
+        const unsigned char token = *ip++;
+
+        size_t literal_length = token >> 4;
+        if (literal_length == 15)
+            literal_length += read_length(ip, end);
+        if (literal_length > size_t(end - ip) || literal_length > dst_size - op)
+            throw runtime_error("Corrupted LZ block.");
+        memcpy(dst + op, ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+
+        if (ip == end)
+            break;
+
+        if (end - ip < 2)
+            throw runtime_error("Corrupted LZ block.");
+        const size_t offset = ip[0] | (size_t(ip[1]) << 8);
+        ip += 2;
+        size_t match_length = token & 15;
+        if (match_length == 15)
+            match_length += read_length(ip, end);
+        match_length += lz_min_match;
+
+        if (offset == 0 || offset > op || match_length > dst_size - op)
+            throw runtime_error("Corrupted LZ block.");
+        // byte by byte, the match may overlap its own output
+        for (size_t k = 0; k < match_length; ++k, ++op)
+            dst[op] = dst[op - offset];
+    }
+
+    if (op != dst_size)
+        throw runtime_error("Corrupted LZ block.");
+}
+
+void shuffle_bytes(const unsigned char* src, const size_t& size, const size_t& element_size, unsigned char* dst) {
+    const size_t elements = size / element_size;
+    for (size_t b = 0; b < element_size; ++b)
+        for (size_t e = 0; e < elements; ++e)
+            dst[b * elements + e] = src[e * element_size + b];
+}
+
+void unshuffle_bytes(const unsigned char* src, const size_t& size, const size_t& element_size, unsigned char* dst) {
+    const size_t elements = size / element_size;
+    for (size_t b = 0; b < element_size; ++b)
+        for (size_t e = 0; e < elements; ++e)
+            dst[e * element_size + b] = src[b * elements + e];
+}
+
+Dump_codec::Dump_codec(const Dump_precision& precision, const double& quantum)
+    : _precision(precision), _quantum(quantum) {
+    if (_precision == Dump_precision::quantized && !(_quantum > 0.0))
+        throw runtime_error("Quantized dumps need a positive DUMP_TOLERANCE.");
+}
+
+size_t Dump_codec::element_size() const {
+    return _precision == Dump_precision::single ? sizeof(float) : sizeof(double);
+}
+
+vector<unsigned char> Dump_codec::encode(const VectorXcd& state) const {
+    const size_t components = 2 * state.size();
+    const double* values    = reinterpret_cast<const double*>(state.data());
+
+    vector<unsigned char> raw(components * element_size());
+    switch (_precision) {
+        case Dump_precision::full:
+            memcpy(raw.data(), values, raw.size());
+            break;
+        case Dump_precision::single:
+            for (size_t k = 0; k < components; ++k) {
+                const float v = static_cast<float>(values[k]);
+                memcpy(raw.data() + k * sizeof(v), &v, sizeof(v));
+            }
+            break;
+        case Dump_precision::quantized:
+            // zigzag, so that small negative values have zero high bytes as well
+            for (size_t k = 0; k < components; ++k) {
+                const int64_t q  = llround(values[k] / _quantum);
+                const uint64_t v = (static_cast<uint64_t>(q) << 1) ^ static_cast<uint64_t>(q >> 63);
+                memcpy(raw.data() + k * sizeof(v), &v, sizeof(v));
+            }
+            break;
+    }
+
+    vector<unsigned char> shuffled(raw.size());
+    shuffle_bytes(raw.data(), raw.size(), element_size(), shuffled.data());
+    const auto compressed = lz_compress(shuffled.data(), shuffled.size());
+
+    Dump_block block;
+    block.compressed             = compressed.size() < shuffled.size();
+    block.payload_size           = block.compressed ? compressed.size() : shuffled.size();
+    const unsigned char* payload = block.compressed ? compressed.data() : shuffled.data();
+
+    vector<unsigned char> out(sizeof(block) + block.payload_size);
+    memcpy(out.data(), &block, sizeof(block));
+    memcpy(out.data() + sizeof(block), payload, block.payload_size);
+    return out;
+}
+
+VectorXcd Dump_codec::decode(const unsigned char* data, const size_t& size, const Index& cols) const {
+    Dump_block block;
+    if (size < sizeof(block))
+        throw runtime_error("Corrupted dump block.");
+    memcpy(&block, data, sizeof(block));
+    if (sizeof(block) + block.payload_size > size)
+        throw runtime_error("Corrupted dump block.");
+
+    const size_t components = 2 * cols;
+    vector<unsigned char> shuffled(components * element_size());
+    if (block.compressed) {
+        lz_decompress(data + sizeof(block), block.payload_size, shuffled.data(), shuffled.size());
+    } else {
+        if (block.payload_size != shuffled.size())
+            throw runtime_error("Corrupted dump block.");
+        memcpy(shuffled.data(), data + sizeof(block), shuffled.size());
+    }
+
+    vector<unsigned char> raw(shuffled.size());
+    unshuffle_bytes(shuffled.data(), shuffled.size(), element_size(), raw.data());
+
+    VectorXcd state(cols);
+    double* values = reinterpret_cast<double*>(state.data());
+    switch (_precision) {
+        case Dump_precision::full:
+            memcpy(values, raw.data(), raw.size());
+            break;
+        case Dump_precision::single:
+            for (size_t k = 0; k < components; ++k) {
+                float v;
+                memcpy(&v, raw.data() + k * sizeof(v), sizeof(v));
+                values[k] = v;
+            }
+            break;
+        case Dump_precision::quantized:
+            for (size_t k = 0; k < components; ++k) {
+                uint64_t v;
+                memcpy(&v, raw.data() + k * sizeof(v), sizeof(v));
+                const int64_t q = static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+                values[k]       = q * _quantum;
+            }
+            break;
+    }
+    return state;
+}
+
+Dump_reader::Dump_reader(const string& path) : _path(path), _file(path, ios::in | ios::binary) {
+    if (!_file.is_open())
+        throw runtime_error("Cannot open dump file: " + path);
+
+    _file.read(reinterpret_cast<char*>(&_header), sizeof(_header));
+    const Dump_header reference;
+    if (!_file || !equal(begin(reference.magic), end(reference.magic), begin(_header.magic)) ||
+        _header.version != reference.version)
+        throw runtime_error("Not a dump file of this version: " + path);
+
+    _U.resize(_header.rows, _header.cols);
+    _file.read(reinterpret_cast<char*>(_U.data()), _U.size() * sizeof(complex<double>));
+
+    Dump_trailer trailer;
+    _file.seekg(-static_cast<streamoff>(sizeof(trailer)), ios::end);
+    _file.read(reinterpret_cast<char*>(&trailer), sizeof(trailer));
+    const Dump_trailer reference_trailer;
+    if (!_file || !equal(begin(reference_trailer.magic), end(reference_trailer.magic), begin(trailer.magic)))
+        throw runtime_error("Dump file has no index, the run was interrupted: " + path);
+
+    _index.resize(trailer.count);
+    _file.seekg(trailer.index_offset);
+    _file.read(reinterpret_cast<char*>(_index.data()), _index.size() * sizeof(Dump_index_entry));
+    if (!_file)
+        throw runtime_error("Dump file index is truncated: " + path);
+
+    _codec = make_unique<Dump_codec>(static_cast<Dump_precision>(_header.precision), _header.quantum);
+}
+
+size_t Dump_reader::nearest(const double& time) const {
+    if (_index.empty())
+        throw runtime_error("Dump file is empty: " + _path);
+
+    const auto it = lower_bound(_index.begin(), _index.end(), time,
+                                [](const Dump_index_entry& e, const double& t) { return e.time < t; });
+    if (it == _index.end())
+        return _index.size() - 1;
+    if (it != _index.begin() && time - prev(it)->time < it->time - time)
+        return it - _index.begin() - 1;
+    return it - _index.begin();
+}
+
+MatrixXcd Dump_reader::state(const size_t& i) {
+    const auto& e = entry(i);
+    vector<unsigned char> block(e.size);
+    _file.seekg(e.offset);
+    _file.read(reinterpret_cast<char*>(block.data()), block.size());
+    if (!_file)
+        throw runtime_error("Dump file is truncated: " + _path);
+    const VectorXcd state = _codec->decode(block.data(), block.size(), _header.cols * _header.orbitals);
+    return Map<const MatrixXcd>(state.data(), _header.cols, _header.orbitals);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <eigen3/Eigen/Dense>
+
+#include "control_data.h"
+
+// Binary dump file DUMP_PATH/dump.bin. Layout:
+//   Dump_header                     magic, version, codec, rows and cols of U, orbitals
+//   U                               complex<double>, column-major, rows x cols
+//   blocks                          one encoded state of cols x orbitals coefficients in the reduced
+//                                   basis each, orbital after orbital
+//   Dump_index_entry[count]         step, time, offset and size of every block
+//   Dump_trailer                    offset of the index, count, magic
+// The states in the original basis are U * state.
+struct Dump_header {
+    char magic[8]{'P', 'T', 'D', 'D', 'U', 'M', 'P', 0};
+    std::uint32_t version{3};
+    std::uint32_t precision{0};  // Dump_precision
+    std::uint64_t rows{0};
+    std::uint64_t cols{0};
+    std::uint64_t orbitals{1};
+    double quantum{0.0};  // step of the quantized coefficients
+};
+
+struct Dump_block {
+    std::uint32_t compressed{0};  // 1 if the payload is LZ compressed, 0 if stored
+    std::uint32_t payload_size{0};
+};
+
+struct Dump_index_entry {
+    std::int64_t step{0};
+    double time{0.0};
+    std::uint64_t offset{0};
+    std::uint64_t size{0};  // including Dump_block
+};
+
+struct Dump_trailer {
+    std::uint64_t index_offset{0};
+    std::uint64_t count{0};
+    char magic[8]{'P', 'T', 'D', 'I', 'N', 'D', 'E', 'X'};
+};
+
+// LZ77 block compression in the LZ4 sequence layout: token (literal length << 4 | match length - 4),
+// extended lengths as runs of 255, literals, 2 byte little endian offset; the last sequence has
+// literals only.
+std::vector<unsigned char> lz_compress(const unsigned char* src, const std::size_t& size);
+void lz_decompress(const unsigned char* src, const std::size_t& size, unsigned char* dst, const std::size_t& dst_size);
+
+// groups byte k of all elements of element_size bytes together, so that slowly varying exponent
+// and sign bytes form long runs for the LZ stage
+void shuffle_bytes(const unsigned char* src,
+                   const std::size_t& size,
+                   const std::size_t& element_size,
+                   unsigned char* dst);
+void unshuffle_bytes(const unsigned char* src,
+                     const std::size_t& size,
+                     const std::size_t& element_size,
+                     unsigned char* dst);
+
+// State coefficients stored as doubles, floats, or integer multiples of quantum (error at most
+// quantum / 2 per component), byte shuffled and LZ compressed.
+class Dump_codec {
+   public:
+    Dump_codec(const Dump_precision& precision, const double& quantum);
+
+    // Dump_block followed by the payload
+    std::vector<unsigned char> encode(const Eigen::VectorXcd& state) const;
+    Eigen::VectorXcd decode(const unsigned char* block, const std::size_t& size, const Eigen::Index& cols) const;
+
+   private:
+    std::size_t element_size() const;
+
+    const Dump_precision _precision;
+    const double _quantum;
+};
+
+// random access to the states of a binary dump through its index
+class Dump_reader {
+   public:
+    explicit Dump_reader(const std::string& path);
+
+    std::size_t count() const { return _index.size(); }
+    const Dump_index_entry& entry(const std::size_t& i) const { return _index.at(i); }
+    const Eigen::MatrixXcd& U() const { return _U; }
+    std::size_t orbitals() const { return _header.orbitals; }
+
+    // index of the registered state closest to time
+    std::size_t nearest(const double& time) const;
+    // state i in the reduced basis, one column per orbital
+    Eigen::MatrixXcd state(const std::size_t& i);
+
+   private:
+    const std::string _path;
+    std::ifstream _file{};
+    Dump_header _header{};
+    Eigen::MatrixXcd _U{};
+    std::vector<Dump_index_entry> _index{};
+    std::unique_ptr<Dump_codec> _codec{};
+};
@@ -0,0 +1,178 @@
+#include "dump_writer.h"
+
+#include <unistd.h>
+
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+#include <utility>
+
+using namespace std;
+using namespace Eigen;
+
+Dump_writer::Dump_writer(const Control_data& control,
+                         const MatrixXcd& U,
+                         const vector<Dump_index_entry>& resume,
+                         const size_t& capacity)
+    : _format(control.dump_format),
+      _dump_path(control.dump_path),
+      _U(U),
+      _codec(control.dump_precision, 2.0 * control.dump_tolerance),
+      _capacity(max<size_t>(capacity, 1)) {
+    if (_format == Dump_format::binary) {
+        const string path = _dump_path + "/dump.bin";
+
+        Dump_header header;
+        header.precision = static_cast<std::uint32_t>(control.dump_precision);
+        header.rows      = _U.rows();
+        header.cols      = _U.cols();
+        header.orbitals  = control.orbitals;
+        header.quantum   = 2.0 * control.dump_tolerance;
+
+        if (resume.empty()) {
+            _file.open(path, ios::out | ios::binary | ios::trunc);
+            if (!_file.is_open())
+                throw runtime_error("Cannot open dump file: " + path);
+
+            _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            _file.write(reinterpret_cast<const char*>(_U.data()), _U.size() * sizeof(complex<double>));
+            _offset = sizeof(header) + _U.size() * sizeof(complex<double>);
+        } else {
+            _offset = resume.back().offset + resume.back().size;
+            _index  = resume;
+            if (truncate(path.c_str(), _offset) != 0)
+                throw runtime_error("Cannot truncate dump file for restart: " + path);
+
+            _file.open(path, ios::in | ios::out | ios::binary);
+            if (!_file.is_open())
+                throw runtime_error("Cannot open dump file: " + path);
+
+            Dump_header existing;
+            _file.read(reinterpret_cast<char*>(&existing), sizeof(existing));
+            if (!_file || memcmp(&existing, &header, sizeof(header)) != 0)
+                throw runtime_error("Dump file does not match the restarted run: " + path);
+            _file.seekp(_offset);
+        }
+    }
+
+    _thread = thread(&Dump_writer::run, this);
+}
+
+// errors were already reported by push or by an explicit close
+Dump_writer::~Dump_writer() {
+    try {
+        close();
+    } catch (...) {
+    }
+}
+
+void Dump_writer::push(const int& step, const double& time, const VectorXcd& state) {
+    unique_lock<mutex> lock(_mutex);
+    _not_full.wait(lock, [&] { return _queue.size() < _capacity || _error; });
+    rethrow_error();
+
+    _queue.push_back(Record{step, time, state});
+    lock.unlock();
+    _not_empty.notify_one();
+}
+
+vector<Dump_index_entry> Dump_writer::synchronize() {
+    unique_lock<mutex> lock(_mutex);
+    _idle.wait(lock, [&] { return (_queue.empty() && _in_flight == 0) || _error; });
+    rethrow_error();
+    return _index;
+}
+
+void Dump_writer::close() {
+    {
+        lock_guard<mutex> lock(_mutex);
+        _closing = true;
+    }
+    _not_empty.notify_one();
+    if (_thread.joinable())
+        _thread.join();
+
+    lock_guard<mutex> lock(_mutex);
+    rethrow_error();
+}
+
+void Dump_writer::rethrow_error() {
+    if (_error)
+        rethrow_exception(_error);
+}
+
+void Dump_writer::run() {
+    try {
+        vector<Record> chunk;
+        chunk.reserve(s_chunk_states);
+
+        for (;;) {
+            {
+                unique_lock<mutex> lock(_mutex);
+                _not_empty.wait(lock, [&] { return !_queue.empty() || _closing; });
+                if (_queue.empty())
+                    break;
+
+                while (!_queue.empty() && chunk.size() < s_chunk_states) {
+                    chunk.push_back(move(_queue.front()));
+                    _queue.pop_front();
+                }
+                _in_flight = chunk.size();
+            }
+            _not_full.notify_all();
+
+            if (_format == Dump_format::binary) {
+                write_binary(chunk);
+            } else {
+                for (const auto& record : chunk)
+                    write_text(record);
+            }
+            chunk.clear();
+
+            {
+                lock_guard<mutex> lock(_mutex);
+                _in_flight = 0;
+            }
+            _idle.notify_all();
+        }
+
+        if (_format == Dump_format::binary) {
+            Dump_trailer trailer;
+            trailer.index_offset = _offset;
+            trailer.count        = _index.size();
+            _file.write(reinterpret_cast<const char*>(_index.data()), _index.size() * sizeof(Dump_index_entry));
+            _file.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+            _file.close();
+            if (!_file)
+                throw runtime_error("Writing dump file failed: " + _dump_path + "/dump.bin");
+        }
+    } catch (...) {
+        lock_guard<mutex> lock(_mutex);
+        _error = current_exception();
+        _queue.clear();
+        _not_full.notify_all();
+        _idle.notify_all();
+    }
+}
+
+void Dump_writer::write_binary(const vector<Record>& chunk) {
+    for (const auto& record : chunk) {
+        const auto block = _codec.encode(record.state);
+        _index.push_back(Dump_index_entry{record.step, record.time, _offset, block.size()});
+        _file.write(reinterpret_cast<const char*>(block.data()), block.size());
+        _offset += block.size();
+    }
+    _file.flush();
+    if (!_file)
+        throw runtime_error("Writing dump file failed: " + _dump_path + "/dump.bin");
+}
+
+void Dump_writer::write_text(const Record& record) {
+    const string path = _dump_path + "/dump-" + to_string(record.step) + ".dat";
+    ofstream dump{path};
+    if (!dump.is_open())
+        throw runtime_error("Cannot open dump file: " + path);
+
+    const Map<const MatrixXcd> orbitals(record.state.data(), _U.cols(), record.state.size() / _U.cols());
+    dump << "# t = " << scientific << record.time << '\n' << setprecision(5) << _U * orbitals;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <eigen3/Eigen/Dense>
+
+#include "control_data.h"
+#include "dump_codec.h"
+
+// Writes the registered states on a background thread, so that the propagation only copies
+// the state into a bounded queue and blocks only if the writer falls capacity states behind.
+// Encoding (DUMP_PRECISION, compression) happens on the writer thread as well.
+// Errors of the writer are rethrown by the next push or by close.
+class Dump_writer {
+   public:
+    // with a non-empty resume index an existing binary dump is truncated after its last entry
+    // and continued, as needed for a restart from a checkpoint
+    Dump_writer(const Control_data& control,
+                const Eigen::MatrixXcd& U,
+                const std::vector<Dump_index_entry>& resume = {},
+                const std::size_t& capacity = 64);
+    ~Dump_writer();
+
+    Dump_writer(const Dump_writer&) = delete;
+    Dump_writer& operator=(const Dump_writer&) = delete;
+
+    // state holds the ORBITALS columns of the block one after another
+    void push(const int& step, const double& time, const Eigen::VectorXcd& state);
+
+    // waits until all pushed states are written, returns the index of the binary dump so far
+    std::vector<Dump_index_entry> synchronize();
+
+    // writes the remaining states and the index, waits for the writer thread
+    void close();
+
+   private:
+    struct Record {
+        int step;
+        double time;
+        Eigen::VectorXcd state;
+    };
+
+    static constexpr std::size_t s_chunk_states = 32;
+
+    void run();
+    void write_binary(const std::vector<Record>& chunk);
+    void write_text(const Record& record);
+    void rethrow_error();
+
+    const Dump_format _format;
+    const std::string _dump_path;
+    const Eigen::MatrixXcd _U;
+    const Dump_codec _codec;
+    const std::size_t _capacity;
+
+    std::fstream _file{};
+    std::uint64_t _offset{0};
+    std::vector<Dump_index_entry> _index{};
+
+    std::mutex _mutex{};
+    std::condition_variable _not_empty{};
+    std::condition_variable _not_full{};
+    std::condition_variable _idle{};
+    std::deque<Record> _queue{};
+    std::size_t _in_flight{0};
+    bool _closing{false};
+    std::exception_ptr _error{};
+    std::thread _thread{};
+};
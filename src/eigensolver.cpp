@@ -0,0 +1,133 @@
+#include "eigensolver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+using namespace Eigen;
+
+Davidson_solver::Davidson_solver(const MatrixXcd& H, const MatrixXcd& S, const double& tolerance)
+    : _H(H), _tolerance(tolerance) {
+    if (!S.isDiagonal(0.0))
+        throw runtime_error("Davidson eigensolver requires diagonal S, run cut_linear_dependencies first.");
+
+    _S_inv_sqrt = S.diagonal().real().cwiseSqrt().cwiseInverse();
+    _diagonal   = H.diagonal().real().cwiseProduct(_S_inv_sqrt.cwiseAbs2());
+}
+
+namespace {
+
+// orthogonalizes t twice against V and the first added columns of W, appends it to W unless it
+// is numerically in their span
+bool add_correction(const MatrixXcd& V, MatrixXcd& W, Index& added, VectorXcd t) {
+    const double initial_norm = t.norm();
+    for (int pass = 0; pass < 2; ++pass) {
+        t -= V * (V.adjoint() * t);
+        t -= W.leftCols(added) * (W.leftCols(added).adjoint() * t);
+    }
+
+    const double t_norm = t.norm();
+    if (!(t_norm > 1.0e-8 * initial_norm))
+        return false;
+    W.col(added++) = t / t_norm;
+    return true;
+}
+
+}  // namespace
+
+void Davidson_solver::compute(const int& count) {
+    const Index n = _H.rows();
+    if (count < 1 || count > n)
+        throw runtime_error("Number of requested eigenstates must be between 1 and the basis size.");
+
+    const Index max_dim      = min<Index>(n, max<Index>(8 * count, 32));
+    const Index restart      = min<Index>(n, 2 * count);
+    const int max_iterations = 1000;
+
+    // S^-1/2 H S^-1/2 V
+    auto apply = [&](const MatrixXcd& V) -> MatrixXcd {
+        _matvecs += V.cols();
+        return _S_inv_sqrt.asDiagonal() * (_H * (_S_inv_sqrt.asDiagonal() * V));
+    };
+
+    // starting guesses are unit vectors of the lowest diagonal elements
+    vector<Index> order(n);
+    iota(order.begin(), order.end(), 0);
+    partial_sort(order.begin(), order.begin() + count, order.end(),
+                 [&](const Index& a, const Index& b) { return _diagonal(a) < _diagonal(b); });
+
+    MatrixXcd V = MatrixXcd::Zero(n, count);
+    for (Index j = 0; j < count; ++j)
+        V(order[j], j) = 1.0;
+    MatrixXcd AV = apply(V);
+
+    for (_iterations = 1; _iterations <= max_iterations; ++_iterations) {
+        const Index m = V.cols();
+        _subspace     = max<int>(_subspace, m);
+
+        MatrixXcd T = V.adjoint() * AV;
+        T           = (T + T.adjoint()).eval() / 2.0;
+        SelfAdjointEigenSolver<MatrixXcd> es(T);
+
+        const MatrixXcd Y    = es.eigenvectors().leftCols(count);
+        const VectorXd theta = es.eigenvalues().head(count);
+        const MatrixXcd X    = V * Y;
+        const MatrixXcd R    = AV * Y - X * theta.asDiagonal();
+
+        // preconditioned corrections of the unconverged pairs
+        MatrixXcd W(n, count);
+        Index added = 0;
+        for (Index j = 0; j < count; ++j) {
+            if (R.col(j).norm() <= _tolerance)
+                continue;
+
+            VectorXcd t = R.col(j);
+            for (Index i = 0; i < n; ++i) {
+                double denominator = theta(j) - _diagonal(i);
+                if (abs(denominator) < 1.0e-8)
+                    denominator = denominator < 0.0 ? -1.0e-8 : 1.0e-8;
+                t(i) /= denominator;
+            }
+
+            // the preconditioned residual may fall into span V when the diagonal is a very good
+            // approximation of H, the bare residual is used then
+            if (!add_correction(V, W, added, t))
+                add_correction(V, W, added, R.col(j));
+        }
+
+        if (added == 0) {
+            if ((R.colwise().norm().array() <= _tolerance).all() || m == n) {
+                _eigenvalues  = theta;
+                _eigenvectors = _S_inv_sqrt.asDiagonal() * X;
+                return;
+            }
+            throw runtime_error("Davidson eigensolver stagnated.");
+        }
+
+        // thick restart from the lowest Ritz vectors when the subspace gets too large
+        // (the corrections stay orthogonal, the new V lies in the span of the old one)
+        if (m + added > max_dim) {
+            const MatrixXcd Z = es.eigenvectors().leftCols(min(restart, m));
+            V                 = (V * Z).eval();
+            AV                = (AV * Z).eval();
+        }
+
+        const Index old = V.cols();
+        V.conservativeResize(NoChange, old + added);
+        AV.conservativeResize(NoChange, old + added);
+        V.rightCols(added)  = W.leftCols(added);
+        AV.rightCols(added) = apply(W.leftCols(added));
+    }
+
+    throw runtime_error("Davidson eigensolver did not converge in " + to_string(max_iterations) + " iterations.");
+}
+
+void Davidson_solver::print_statistics(ostream& os) const {
+    os << " Davidson eigensolver:\n"
+       << "   iterations:              " << _iterations << '\n'
+       << "   H matvecs:               " << _matvecs << '\n'
+       << "   largest subspace:        " << _subspace << "\n\n";
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <iostream>
+
+#include <eigen3/Eigen/Dense>
+
+// Block Davidson for the count lowest eigenpairs of H x = e S x with diagonal S, as left by
+// Integrals::cut_linear_dependencies. Works on S^-1/2 H S^-1/2 through matvecs with H, so only
+// O(N^2 count) operations per iteration instead of the O(N^3) full diagonalization; corrections
+// are preconditioned with the diagonal (e - H_ii / S_ii)^-1. Eigenvectors are S-normalized.
+class Davidson_solver {
+   public:
+    Davidson_solver(const Eigen::MatrixXcd& H, const Eigen::MatrixXcd& S, const double& tolerance);
+
+    // throws if the residuals do not drop below tolerance
+    void compute(const int& count);
+
+    const Eigen::VectorXd& eigenvalues() const { return _eigenvalues; }
+    const Eigen::MatrixXcd& eigenvectors() const { return _eigenvectors; }
+
+    void print_statistics(std::ostream& os) const;
+
+   private:
+    const Eigen::MatrixXcd& _H;
+    Eigen::VectorXd _S_inv_sqrt{};
+    Eigen::VectorXd _diagonal{};
+    const double _tolerance;
+
+    Eigen::VectorXd _eigenvalues{};
+    Eigen::MatrixXcd _eigenvectors{};
+
+    int _iterations{0};
+    long _matvecs{0};
+    int _subspace{0};
+};
@@ -0,0 +1,161 @@
+#include "integrals_cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include "native_reader.h"
+#include "utils.h"
+
+using namespace std;
+using namespace Eigen;
+
+namespace {
+
+constexpr char cache_magic[8]         = {'P', 'T', 'D', 'C', 'A', 'C', 'H', 'E'};
+constexpr std::uint32_t cache_version = 3;
+
+// for the native format the header already holds checksums of all matrices
+std::uint64_t integrals_content_hash(const Control_data& control) {
+    const string path = control.integrals_format == Integrals_format::native
+                            ? native_integrals_path(control)
+                            : control.resources_path + "/" + control.file1E;
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw runtime_error("Unable to open integrals file: " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw runtime_error("Unable to stat integrals file: " + path);
+    }
+
+    std::size_t size = st.st_size;
+    if (control.integrals_format == Integrals_format::native)
+        size = min(size, sizeof(Native_header));
+    if (size == 0) {
+        close(fd);
+        return hash_bytes(nullptr, 0);
+    }
+
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        throw runtime_error("Unable to map integrals file: " + path);
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    const std::uint64_t hash = hash_bytes(map, size);
+    munmap(map, size);
+    return hash;
+}
+
+template <typename Derived>
+void write_matrix(ofstream& file, const MatrixBase<Derived>& m) {
+    const std::int64_t rows = m.rows(), cols = m.cols();
+    file.write(reinterpret_cast<const char*>(&rows), sizeof(rows));
+    file.write(reinterpret_cast<const char*>(&cols), sizeof(cols));
+    file.write(reinterpret_cast<const char*>(m.derived().data()), rows * cols * sizeof(typename Derived::Scalar));
+}
+
+// false unless the stored matrix is rows x cols, or empty where that is allowed
+template <typename Derived>
+bool read_matrix(ifstream& file, PlainObjectBase<Derived>& m, const std::int64_t& rows, const std::int64_t& cols,
+                 const bool& may_be_empty = false) {
+    std::int64_t stored_rows = 0, stored_cols = 0;
+    file.read(reinterpret_cast<char*>(&stored_rows), sizeof(stored_rows));
+    file.read(reinterpret_cast<char*>(&stored_cols), sizeof(stored_cols));
+    const bool empty = may_be_empty && stored_rows == 0 && stored_cols == 0;
+    if (!file || (!empty && (stored_rows != rows || stored_cols != cols)))
+        return false;
+    m.resize(stored_rows, stored_cols);
+    file.read(reinterpret_cast<char*>(m.data()), stored_rows * stored_cols * sizeof(typename Derived::Scalar));
+    return static_cast<bool>(file);
+}
+
+}  // namespace
+
+string integrals_cache_path(const Control_data& control) {
+    std::uint64_t key = integrals_content_hash(control);
+    key               = hash_bytes(&Control_data::s_eigenval_threshold, sizeof(double), key);
+    key               = hash_bytes(&control.representation, sizeof(control.representation), key);
+    key               = hash_bytes(&cache_version, sizeof(cache_version), key);
+    // only the operators the run needs are stored
+    const bool operators[2] = {Integrals::gradient_required(control), control.use_cap};
+    key                     = hash_bytes(operators, sizeof(operators), key);
+    // the iterative eigensolver stores only the lowest eigenstates
+    key = hash_bytes(&control.eigensolver, sizeof(control.eigensolver), key);
+    if (control.eigensolver == Eigensolver::davidson) {
+        key = hash_bytes(&control.eigenstates, sizeof(control.eigenstates), key);
+        key = hash_bytes(&control.eigensolver_tol, sizeof(control.eigensolver_tol), key);
+    }
+
+    ostringstream name;
+    name << control.cache_path << "/ints-" << hex << setw(16) << setfill('0') << key << ".ptc";
+    return name.str();
+}
+
+bool load_integrals_cache(const string& path, Prepared_integrals& prepared) {
+    ifstream file(path, ios::in | ios::binary);
+    if (!file.is_open())
+        return false;
+
+    char magic[8];
+    std::uint32_t version = 0;
+    std::int64_t sizes[3] = {0, 0, 0};  // basis, reduced basis, eigenstates
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(sizes), sizeof(sizes));
+    if (!file || !equal(magic, magic + sizeof(magic), cache_magic) || version != cache_version)
+        return false;
+
+    const std::int64_t n = sizes[0], m = sizes[1], e = sizes[2];
+    if (n <= 0 || m <= 0 || m > n || e <= 0 || e > m)
+        return false;
+
+    // a truncated or inconsistent cache is a miss, the setup is then recomputed from the integrals
+    auto& ints      = prepared.ints;
+    bool consistent = read_matrix(file, ints.S, m, m) && read_matrix(file, ints.H, m, m);
+    for (auto X : {&ints.Dx, &ints.Dy, &ints.Dz, &ints.Gx, &ints.Gy, &ints.Gz, &ints.CAP})
+        consistent = consistent && read_matrix(file, *X, m, m, true);
+    consistent = consistent && read_matrix(file, prepared.U, n, m) && read_matrix(file, prepared.energies, e, 1) &&
+                 read_matrix(file, prepared.eigenvectors, m, e);
+
+    if (!consistent) {
+        prepared = Prepared_integrals{};
+        return false;
+    }
+    return true;
+}
+
+void save_integrals_cache(const string& path, const Prepared_integrals& prepared) {
+    const string tmp_path = path + ".tmp";
+    ofstream file(tmp_path, ios::out | ios::binary | ios::trunc);
+    if (!file.is_open())
+        throw runtime_error("Cannot open integrals cache: " + tmp_path);
+
+    file.write(cache_magic, sizeof(cache_magic));
+    file.write(reinterpret_cast<const char*>(&cache_version), sizeof(cache_version));
+    const std::int64_t sizes[3] = {prepared.U.rows(), prepared.U.cols(), prepared.energies.size()};
+    file.write(reinterpret_cast<const char*>(sizes), sizeof(sizes));
+
+    const auto& ints = prepared.ints;
+    for (auto m : {&ints.S, &ints.H, &ints.Dx, &ints.Dy, &ints.Dz, &ints.Gx, &ints.Gy, &ints.Gz, &ints.CAP})
+        write_matrix(file, *m);
+    write_matrix(file, prepared.U);
+    write_matrix(file, prepared.energies);
+    write_matrix(file, prepared.eigenvectors);
+    file.close();
+
+    if (!file)
+        throw runtime_error("Writing integrals cache failed: " + tmp_path);
+    if (rename(tmp_path.c_str(), path.c_str()) != 0)
+        throw runtime_error("Cannot rename integrals cache to " + path);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+#include <eigen3/Eigen/Dense>
+
+#include "control_data.h"
+#include "procedures.h"
+
+// Orthogonalized integrals, the transformation U and the eigenpairs of H, i.e. everything the
+// setup computes from the integrals file. Cached on disk in CACHE_PATH under a key built from
+// the content of the integrals file, the linear dependency threshold, the representation, the
+// set of required operators and the eigensolver settings.
+struct Prepared_integrals {
+    Integrals ints{};
+    Eigen::MatrixXcd U{};
+    Eigen::VectorXd energies{};
+    Eigen::MatrixXcd eigenvectors{};
+};
+
+std::string integrals_cache_path(const Control_data& control);
+
+bool load_integrals_cache(const std::string& path, Prepared_integrals& prepared);
+
+void save_integrals_cache(const std::string& path, const Prepared_integrals& prepared);
@@ -0,0 +1,111 @@
+#include "interaction.h"
+
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+
+#include "constants.h"
+
+using namespace std;
+using namespace Eigen;
+
+Interaction::Interaction(const Control_data& control, const Integrals& ints)
+    : _gauge(control.gauge),
+      _ints(ints),
+      _omega(control.opt_omega_eV / au_to_ev),
+      _cycles(control.opt_cycles),
+      _pcep(control.opt_carrier_envelope) {
+    switch (_gauge) {
+        case Gauge::length:
+        case Gauge::velocity:
+        case Gauge::velocity_with_Asqrt:
+            break;
+        default:
+            throw runtime_error("Currently only length and velocity gauge are supported!");
+    }
+
+    _E0 = control.opt_fielddir;
+    _E0 /= _E0.norm();
+    _polarization = _E0;
+    _E0 *= sqrt(control.opt_intensity / intensity_to_au);
+    _pulse_end = _cycles * 2 * M_PI / _omega;
+}
+
+Vector3cd Interaction::field(const double& time) const {
+    if (time >= _pulse_end)
+        return Vector3cd{0, 0, 0};
+
+    const auto& omega  = _omega;
+    const auto& cycles = _cycles;
+    const auto& pcep   = _pcep;
+
+    Vector3cd E0 = _E0;
+    switch (_gauge) {
+        case Gauge::length:
+            E0 *= sin(omega * time / (2 * cycles)) * sin(omega * time / (2 * cycles)) * sin(omega * time + pcep);
+            break;
+        default:
+            E0 *= -1.0 / (omega * (2.0 - 2.0 / (cycles * cycles))) *
+                  (-cos(pcep) / (cycles * cycles) +
+                   (-1.0 + 1.0 / (cycles * cycles) + cos(omega * time / cycles)) * cos(omega * time + pcep) +
+                   (1.0 / cycles) * sin(omega * time / cycles) * sin(omega * time + pcep));
+            break;
+    }
+    return E0;
+}
+
+double Interaction::amplitude(const double& time) const {
+    return _polarization.dot(field(time)).real();
+}
+
+double Interaction::envelope(const double& time) const {
+    if (time >= _pulse_end || time <= 0.0)
+        return 0.0;
+    return sin(_omega * time / (2 * _cycles)) * sin(_omega * time / (2 * _cycles));
+}
+
+MatrixXcd Interaction::matrix(const double& time) const {
+    const auto field = this->field(time);
+    switch (_gauge) {
+        case Gauge::length:
+            return field(0) * _ints.Dx + field(1) * _ints.Dy + field(2) * _ints.Dz;
+        case Gauge::velocity:
+            return -1.0i * (field(0) * _ints.Gx + field(1) * _ints.Gy + field(2) * _ints.Gz);
+        default:
+            return -1.0i * (field(0) * _ints.Gx + field(1) * _ints.Gy + field(2) * _ints.Gz) +
+                   _ints.S * field.squaredNorm() / 2.0;
+    }
+}
+
+VectorXcd Interaction::apply(const double& time, const VectorXcd& state) const {
+    const auto field = this->field(time);
+    VectorXcd res    = VectorXcd::Zero(state.size());
+    if (field.isZero(0.0))
+        return res;
+
+    const bool length     = _gauge == Gauge::length;
+    const MatrixXcd* V[3] = {length ? &_ints.Dx : &_ints.Gx, length ? &_ints.Dy : &_ints.Gy,
+                             length ? &_ints.Dz : &_ints.Gz};
+    for (int k = 0; k < 3; ++k) {
+        if (field(k) != 0.0)
+            res.noalias() += field(k) * (*V[k] * state);
+    }
+
+    if (!length)
+        res *= -1.0i;
+    if (_gauge == Gauge::velocity_with_Asqrt)
+        res += _ints.S * state * field.squaredNorm() / 2.0;
+    return res;
+}
+
+MatrixXcd Interaction::coupling() const {
+    const auto& e = _polarization;
+    switch (_gauge) {
+        case Gauge::length:
+            return e(0) * _ints.Dx + e(1) * _ints.Dy + e(2) * _ints.Dz;
+        case Gauge::velocity:
+            return -1.0i * (e(0) * _ints.Gx + e(1) * _ints.Gy + e(2) * _ints.Gz);
+        default:
+            throw runtime_error("Interaction is not linear in the field amplitude in this gauge.");
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <eigen3/Eigen/Dense>
+
+#include "control_data.h"
+#include "procedures.h"
+
+// laser pulse coupling in the chosen gauge; H_int(t) = sum_k c_k(t) V_k with
+// V = {Dx, Dy, Dz} in length gauge and V = {Gx, Gy, Gz} (+ S for A^2 term) in velocity gauges
+class Interaction {
+   public:
+    Interaction(const Control_data& control, const Integrals& ints);
+
+    // electric field (length gauge) or vector potential (velocity gauges)
+    Eigen::Vector3cd field(const double& time) const;
+    // projection of field on the polarization direction
+    double amplitude(const double& time) const;
+    // sin^2 pulse envelope in [0, 1], zero after the pulse
+    double envelope(const double& time) const;
+    double pulse_end() const { return _pulse_end; }
+    Gauge gauge() const { return _gauge; }
+
+    Eigen::MatrixXcd matrix(const double& time) const;
+    // H_int(t) * state without forming H_int(t)
+    Eigen::VectorXcd apply(const double& time, const Eigen::VectorXcd& state) const;
+    // V such that H_int(t) = amplitude(t) V; length and velocity gauge only
+    Eigen::MatrixXcd coupling() const;
+
+   private:
+    const Gauge _gauge;
+    const Integrals& _ints;
+
+    Eigen::Vector3cd _E0{};
+    Eigen::Vector3cd _polarization{};
+    double _omega{};
+    double _cycles{};
+    double _pcep{};
+    double _pulse_end{};
+};
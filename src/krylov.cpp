@@ -0,0 +1,104 @@
+#include "krylov.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+
+#include <eigen3/unsupported/Eigen/MatrixFunctions>
+
+using namespace std;
+using namespace Eigen;
+
+Krylov_exponential::Krylov_exponential(const VectorXd& S_diag, const int& max_dim, const double& tolerance)
+    : _S_diag(S_diag), _S_cdiag(S_diag.cast<complex<double>>()), _max_dim(max_dim), _tolerance(tolerance) {
+    if (_max_dim < 1)
+        throw runtime_error("Krylov space dimension has to be positive.");
+    // the error estimate falls like tau^(m-1) against a tau threshold, it cannot be met by shrinking
+    // the substep with fewer vectors
+    if (_tolerance > 0.0 && _max_dim < 4)
+        throw runtime_error("Adaptive Krylov propagation needs KRYLOV_DIM of at least 4.");
+}
+
+double Krylov_exponential::norm(const VectorXcd& state) const {
+    return sqrt(state.cwiseAbs2().dot(_S_diag));
+}
+
+void Krylov_exponential::apply(const Operator& op, VectorXcd& state, const double& dt) {
+    ++_calls;
+    const bool adaptive = _tolerance > 0.0;
+    const auto m_max    = min<Index>(_max_dim, state.size());
+
+    MatrixXcd V(state.size(), m_max);
+    MatrixXcd Hm(m_max, m_max);
+
+    // negative dt (backward substeps of composition schemes) propagates over |dt| backwards
+    const double span = abs(dt);
+    const double sign = dt < 0.0 ? -1.0 : 1.0;
+
+    double t = 0.0;
+    while (span - t > 1.0e-12 * span) {
+        const double beta = norm(state);
+        if (beta == 0.0)
+            return;
+
+        double tau = span - t;
+        Hm.setZero();
+        V.col(0) = state / beta;
+
+        Index m       = m_max;
+        double h_next = 0.0;
+        double err    = 0.0;
+        MatrixXcd E;
+        for (Index j = 0; j < m_max; ++j) {
+            VectorXcd w = op(V.col(j));
+            ++_matvecs;
+            for (Index i = 0; i <= j; ++i) {
+                Hm(i, j) = V.col(i).dot(_S_cdiag.cwiseProduct(w));
+                w -= Hm(i, j) * V.col(i);
+            }
+
+            m      = j + 1;
+            h_next = norm(w);
+            if (h_next <= 1.0e-12 * Hm.col(j).norm()) {
+                h_next = 0.0;
+                break;
+            }
+            if (adaptive) {
+                E   = (-1.0i * sign * tau * Hm.topLeftCorner(m, m)).exp();
+                err = beta * h_next * abs(E(m - 1, 0));
+                if (err <= _tolerance * tau / span)
+                    break;
+            }
+            if (m < m_max) {
+                Hm(j + 1, j) = h_next;
+                V.col(j + 1) = w / h_next;
+            }
+        }
+
+        // the Krylov space does not depend on tau, shrinking the substep only needs new small exponentials
+        E   = (-1.0i * sign * tau * Hm.topLeftCorner(m, m)).exp();
+        err = beta * h_next * abs(E(m - 1, 0));
+        while (adaptive && err > _tolerance * tau / span) {
+            tau *= max(0.2, 0.9 * pow(_tolerance * tau / span / err, 1.0 / m));
+            if (tau <= 1.0e-10 * span)
+                throw runtime_error("Krylov substep fell below 1e-10 DT without meeting PROPAGATOR_TOLERANCE.");
+            E   = (-1.0i * sign * tau * Hm.topLeftCorner(m, m)).exp();
+            err = beta * h_next * abs(E(m - 1, 0));
+        }
+
+        state = beta * V.leftCols(m) * E.col(0);
+        t += tau;
+        ++_substeps;
+    }
+}
+
+void Krylov_exponential::print_statistics(ostream& os) const {
+    os << " Krylov exponential statistics:\n"
+       << "   steps:                    " << _calls << '\n'
+       << "   substeps:                 " << _substeps << '\n'
+       << "   matvecs:                  " << _matvecs << '\n';
+    if (_substeps > 0)
+        os << "   average Krylov dimension: " << static_cast<double>(_matvecs) / _substeps << '\n';
+    os << '\n';
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <functional>
+#include <iostream>
+
+#include <eigen3/Eigen/Dense>
+
+// Action of exp(-i dt S^-1 H) on a vector for diagonal S, with S^-1 H given only through
+// matvecs. The Arnoldi space is built in the S inner product, H may be non-Hermitian (CAP).
+// With positive tolerance the space grows until the a-posteriori estimate
+// beta h_{m+1,m} |[exp(-i tau H_m)]_{m,1}| drops below tolerance * tau / dt, and the step
+// is split into substeps tau when max_dim is not enough. Otherwise max_dim is always used.
+class Krylov_exponential {
+   public:
+    using Operator = std::function<Eigen::VectorXcd(const Eigen::VectorXcd&)>;
+
+    Krylov_exponential(const Eigen::VectorXd& S_diag, const int& max_dim, const double& tolerance);
+
+    void apply(const Operator& op, Eigen::VectorXcd& state, const double& dt);
+
+    void print_statistics(std::ostream& os) const;
+
+   private:
+    double norm(const Eigen::VectorXcd& state) const;
+
+    const Eigen::VectorXd _S_diag;
+    const Eigen::VectorXcd _S_cdiag;
+    const int _max_dim;
+    const double _tolerance;
+
+    long _calls{0};
+    long _substeps{0};
+    long _matvecs{0};
+};
@@ -1,17 +1,32 @@
 #include <chrono>
 #include <cmath>
 #include <complex>
+#include <functional>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <omp.h>
 
 #include <eigen3/Eigen/Dense>
 
 #include "basis.h"
+#include "checkpoint.h"
 #include "constants.h"
 #include "control_data.h"
 #include "disk_reader.h"
+#include "dump_codec.h"
+#include "eigensolver.h"
+#include "integrals_cache.h"
+#include "native_reader.h"
+#include "orientation.h"
 #include "procedures.h"
+#include "propagation.h"
+#include "results_writer.h"
+#include "task_pool.h"
 #include "utils.h"
 
 using namespace std;
@@ -20,8 +35,9 @@ using namespace Eigen;
 int main(int argc, char* argv[]) {
     const Clock clk;
 
-    if (!(argc == 3 || argc == 2)) {
-        cerr << " Proper usage: ./photo <input name> <settings>\n";
+    if (!(argc == 4 || argc == 3 || argc == 2)) {
+        cerr << " Proper usage: ./photo <input name> [-prep | -convert | -export | -dump <time> | "
+                "-restart [<checkpoint>]]\n";
         return EXIT_SUCCESS;
     }
 
@@ -34,192 +50,209 @@ int main(int argc, char* argv[]) {
         return EXIT_SUCCESS;
     }
 
+    if (argc == 3 && string(argv[2]) == "-convert") {
+        cout << " Converting integrals to " << native_integrals_path(control) << "\n";
+        convert_to_native(control);
+
+        cout << " Wall time: " << setprecision(5) << fixed << clk << "\n\n";
+        return EXIT_SUCCESS;
+    }
+
+    // binary results of OUT_PATH/OUT_FILE as text, on the standard output
+    if (argc == 3 && string(argv[2]) == "-export") {
+        export_results_text(control.out_path + "/" + control.out_file, cout);
+        return EXIT_SUCCESS;
+    }
+
+    // state registered closest to time, in the original basis with one column per orbital, from
+    // the binary dump
+    if (argc == 4 && string(argv[2]) == "-dump") {
+        Dump_reader reader(control.dump_path + "/dump.bin");
+        const auto i = reader.nearest(stod(argv[3]));
+        cout << "# t = " << scientific << reader.entry(i).time << '\n'
+             << setprecision(10) << reader.U() * reader.state(i) << '\n';
+        return EXIT_SUCCESS;
+    }
+
     cout << " Number of threads being used: " << Eigen::nbThreads() << "\n\n";
     cout << scientific;
 
-    Integrals ints;
-    ints.read_from_disk(control);
+    if (control.eigensolver == Eigensolver::davidson && control.spectral_basis)
+        throw runtime_error("SPECTRAL_BASIS needs all eigenstates of H, use the dense eigensolver.");
+
+    // orthogonalized integrals and eigenstates of H, taken from CACHE_PATH if they were computed
+    // before for the same integrals file
+    Prepared_integrals prepared;
+    auto& ints = prepared.ints;
+    auto& U    = prepared.U;
+
+    const string cache_file = control.cache_path.empty() ? string{} : integrals_cache_path(control);
+    if (!cache_file.empty() && load_integrals_cache(cache_file, prepared)) {
+        cout << " Integrals and eigenstates of H read from cache " << cache_file << "\n";
+    } else {
+        ints.read_from_disk(control);
 
 #ifdef PHOTO_DEBUG
-    cout << "S  \n" << ints.S << "\n\n";
-    cout << "H  \n" << ints.H << "\n\n";
-    cout << "Dx \n" << ints.Dx << "\n\n";
-    cout << "Dy \n" << ints.Dy << "\n\n";
-    cout << "Dz \n" << ints.Dz << "\n\n";
-    cout << "Gx \n" << ints.Gx << "\n\n";
-    cout << "Gy \n" << ints.Gy << "\n\n";
-    cout << "Gz \n" << ints.Gz << "\n\n";
-    cout << "CAP \n" << ints.CAP << "\n\n";
+        cout << "S  \n" << ints.S << "\n\n";
+        cout << "H  \n" << ints.H << "\n\n";
+        cout << "Dx \n" << ints.Dx << "\n\n";
+        cout << "Dy \n" << ints.Dy << "\n\n";
+        cout << "Dz \n" << ints.Dz << "\n\n";
+        cout << "Gx \n" << ints.Gx << "\n\n";
+        cout << "Gy \n" << ints.Gy << "\n\n";
+        cout << "Gz \n" << ints.Gz << "\n\n";
+        cout << "CAP \n" << ints.CAP << "\n\n";
 #endif
 
-    const auto U = ints.cut_linear_dependencies();
+        U = ints.cut_linear_dependencies();
 
 #ifdef PHOTO_DEBUG
-    cout << " Matrices after transformation\n";
-    cout << "S  \n" << ints.S << "\n\n";
-    cout << "H  \n" << ints.H << "\n\n";
-    cout << "Dx \n" << ints.Dx << "\n\n";
-    cout << "Dy \n" << ints.Dy << "\n\n";
-    cout << "Dz \n" << ints.Dz << "\n\n";
-    cout << "Gx \n" << ints.Gx << "\n\n";
-    cout << "Gy \n" << ints.Gy << "\n\n";
-    cout << "Gz \n" << ints.Gz << "\n\n";
-    cout << "CAP \n" << ints.CAP << "\n\n";
+        cout << " Matrices after transformation\n";
+        cout << "S  \n" << ints.S << "\n\n";
+        cout << "H  \n" << ints.H << "\n\n";
+        cout << "Dx \n" << ints.Dx << "\n\n";
+        cout << "Dy \n" << ints.Dy << "\n\n";
+        cout << "Dz \n" << ints.Dz << "\n\n";
+        cout << "Gx \n" << ints.Gx << "\n\n";
+        cout << "Gy \n" << ints.Gy << "\n\n";
+        cout << "Gz \n" << ints.Gz << "\n\n";
+        cout << "CAP \n" << ints.CAP << "\n\n";
 #endif
 
-    std::function<Vector3cd(const double&)> compute_filed;
-    std::function<MatrixXcd(const double&)> compute_interaction;
-
-    switch (control.gauge) {
-        case Gauge::length:
-            compute_filed = [&](const double& time) {
-                Vector3cd E0 = control.opt_fielddir;
-                E0 /= E0.norm();
-                E0 *= sqrt(control.opt_intensity / intensity_to_au);
-                const double omega = control.opt_omega_eV / au_to_ev;
-                const auto& cycles = control.opt_cycles;
-                const auto& pcep   = control.opt_carrier_envelope;
-
-                if (time >= cycles * 2 * M_PI / omega)
-                    return Vector3cd{0, 0, 0};
-
-                E0 *= sin(omega * time / (2 * cycles)) * sin(omega * time / (2 * cycles)) * sin(omega * time + pcep);
-                return E0;
-            };
-
-            compute_interaction = [&](const double& time) {
-                const auto field = compute_filed(time);
-                return field(0) * ints.Dx + field(1) * ints.Dy + field(2) * ints.Dz;
-            };
-            break;
-        case Gauge::velocity:
-        case Gauge::velocity_with_Asqrt:
-            compute_filed = [&](const double& time) {
-                Vector3cd E0 = control.opt_fielddir;
-                E0 /= E0.norm();
-                E0 *= sqrt(control.opt_intensity / intensity_to_au);
-                const double omega = control.opt_omega_eV / au_to_ev;
-                const auto& cycles = control.opt_cycles;
-                const auto& pcep   = control.opt_carrier_envelope;
-
-                if (time >= cycles * 2 * M_PI / omega)
-                    return Vector3cd{0, 0, 0};
-
-                E0 *= -1.0 / (omega * (2.0 - 2.0 / (cycles * cycles))) *
-                      (-cos(pcep) / (cycles * cycles) +
-                       (-1.0 + 1.0 / (cycles * cycles) + cos(omega * time / cycles)) * cos(omega * time + pcep) +
-                       (1.0 / cycles) * sin(omega * time / cycles) * sin(omega * time + pcep));
-                return E0;
-            };
-
-            switch (control.gauge) {
-                case Gauge::velocity:
-                    compute_interaction = [&](const double& time) {
-                        const auto field = compute_filed(time);
-                        return -1.0i * (field(0) * ints.Gx + field(1) * ints.Gy + field(2) * ints.Gz);
-                    };
-                    break;
-
-                case Gauge::velocity_with_Asqrt:
-                    compute_interaction = [&](const double& time) {
-                        const auto field = compute_filed(time);
-                        return -1.0i * (field(0) * ints.Gx + field(1) * ints.Gy + field(2) * ints.Gz) +
-                               ints.S * field.squaredNorm() / 2.0;
-                    };
-                    break;
-
-                default:
-                    break;
+        if (control.eigensolver == Eigensolver::davidson) {
+            cout << " Computing " << control.eigenstates << " lowest eigenstates of H.\n";
+
+            Davidson_solver davidson(ints.H, ints.S, control.eigensolver_tol);
+            davidson.compute(control.eigenstates);
+            davidson.print_statistics(cout);
+            prepared.energies     = davidson.eigenvalues();
+            prepared.eigenvectors = davidson.eigenvectors();
+        } else {
+            cout << " Computing eigenstates of H.\n";
+
+            GeneralizedSelfAdjointEigenSolver<MatrixXcd> es(ints.H, ints.S);
+            cout << "   EigenSolver info: ";
+            if (check_and_report_eigen_info(cout, es.info())) {
+                cerr << "exiting...\n";
+                return EXIT_FAILURE;
             }
-            break;
+            prepared.energies     = es.eigenvalues();
+            prepared.eigenvectors = es.eigenvectors();
+        }
 
-        default:
-            throw runtime_error("Currently only length and velocity gauge are supported!");
+        if (!cache_file.empty()) {
+            save_integrals_cache(cache_file, prepared);
+            cout << " Integrals and eigenstates of H stored in cache " << cache_file << "\n";
+        }
     }
 
-    cout << " Computing eigenstates of H.\n";
-
-    GeneralizedSelfAdjointEigenSolver<MatrixXcd> es(ints.H, ints.S);
-    cout << "   EigenSolver info: ";
-    if (check_and_report_eigen_info(cout, es.info())) {
-        cerr << "exiting...\n";
-        return EXIT_FAILURE;
-    }
+    if (control.orbitals < 1)
+        throw runtime_error("ORBITALS must be at least 1.");
+    if (control.initial_state < 0 || control.initial_state + control.orbitals > prepared.eigenvectors.cols())
+        throw runtime_error("INITIAL_STATE and the ORBITALS above it must be computed eigenstates of H.");
 
-    //    MatrixXcd LCAO = es.eigenvectors();     //use for full computations
-    VectorXcd state = es.eigenvectors().col(0);  // only the ground state
+    // one column per propagated orbital
+    MatrixXcd state = prepared.eigenvectors.middleCols(control.initial_state, control.orbitals);
     cout << "   Egenvalues of H matrix:\n"
-         << es.eigenvalues().format(IOFormat(StreamPrecision, 0, " ", "\n", "     ", "", "", "")) << "\n\n"
+         << prepared.energies.format(IOFormat(StreamPrecision, 0, " ", "\n", "     ", "", "", "")) << "\n\n"
          << std::flush;
 
-    auto compute_dipole_moment = [&]() {
-        Vector3d dip;
-        //        const VectorXcd state = LCAO.col(0); //use for full computations
-        dip(0) = (state.dot(ints.Dx * state)).real();
-        dip(1) = (state.dot(ints.Dy * state)).real();
-        dip(2) = (state.dot(ints.Dz * state)).real();
-        return dip;
-    };
-
-    auto compute_norm = [&]() { return sqrt(state.dot(ints.S * state).real()); };
-
-    auto compute_energy = [&]() { return state.dot(ints.H * state).real(); };
-
-    cout << " ================= TIME PROPAGATION =================\n";
-    const int steps             = std::round(control.max_t / control.dt);
-    const int register_interval = std::round(control.register_dip / control.dt);
-    double current_time         = 0.0;
-
-    vector<tuple<double, Vector3d, double, double, double>> res;
-    res.reserve(steps / register_interval + 1);
-    res.emplace_back(make_tuple(current_time, compute_dipole_moment(), compute_norm(), compute_energy(), 0.0));
-    if (control.dump) {
-        std::string path = control.dump_path + "/dump-0.dat";
-        std::ofstream dump{path};
-        if (!dump.is_open())
-            throw std::runtime_error("Cannot open dump file: " + path);
+    if (control.spectral_basis) {
+        const VectorXd& energies = prepared.energies;
+        Index kept               = 0;
+        while (kept < energies.size() && energies(kept) * au_to_ev <= control.spectral_cutoff_eV)
+            ++kept;
+        if (kept == 0)
+            throw runtime_error("SPECTRAL_CUTOFF_EV is below the ground state energy.");
+
+        cout << " Moving to the eigenbasis of H, keeping " << kept << " of " << energies.size()
+             << " eigenstates.\n\n";
+        const MatrixXcd C = prepared.eigenvectors.leftCols(kept);
+        ints.transform_to_eigenbasis(energies.head(kept), C);
+        U     = U * C;
+        if (control.initial_state + control.orbitals > kept)
+            throw runtime_error("INITIAL_STATE or ORBITALS is above SPECTRAL_CUTOFF_EV.");
+        state = MatrixXcd::Identity(kept, kept).middleCols(control.initial_state, control.orbitals);
+    }
 
-        dump << "# t = " << std::scientific << current_time << '\n' << std::setprecision(5) << U * state;
+    // every point of the laser parameter sweep and every gauge of GAUGE is propagated from the
+    // same setup, each run with its own log, results, dumps and checkpoints
+    vector<Control_data> runs;
+    const auto points = sweep_points(control);
+    for (const auto& point : points) {
+        const auto gauges = gauge_runs(point);
+        runs.insert(runs.end(), gauges.begin(), gauges.end());
+    }
+    if (points.size() > 1) {
+        const string index_path = control.out_path + "/" + control.job_name + "_sweep.idx";
+        write_sweep_index(index_path, runs);
+        cout << " Sweep over " << points.size() << " laser parameter sets, index in " << index_path << "\n";
     }
 
-    for (int i = 1; i <= steps; ++i) {
-        current_time += control.dt;
-        // Remove CAP if you want
-        const MatrixXcd H_int = compute_interaction(current_time);
-        const MatrixXcd H_t   = ints.H + H_int + ints.CAP;
-        const MatrixXcd A     = ints.S + 1i * control.dt / 2.0 * H_t;
-
-        // const MatrixXcd B     = (S - 1i * control.dt / 2.0 * H_t) * LCAO;//use for full
-        // computations
-        const VectorXcd B = (ints.S - 1i * control.dt / 2.0 * H_t) * state;  // only the ground
-                                                                             // state
-
-        // LCAO           = A.partialPivLu().solve(B);//use for full computations
-        state = A.partialPivLu().solve(B);  // only the ground state
-
-        const auto dip              = compute_dipole_moment();
-        const auto norm             = compute_norm();
-        const auto energy           = compute_energy() / norm / norm;
-        const auto expectation_Hint = state.dot(H_int * state).real() / norm / norm;
-
-        if (i % register_interval == 0) {
-            if (control.dump) {
-                std::ofstream dump{control.dump_path + "/dump-" + std::to_string(i) + ".dat"};
-                dump << "# t = " << std::scientific << current_time << '\n' << std::setprecision(5) << U * state;
-            }
-            res.emplace_back(make_tuple(current_time, dip, norm, energy, expectation_Hint));
-            cout << " Iteration: " << i << " , time: " << current_time << '\n'
-                 << "   dipole moment: " << dip.transpose() << '\n'
-                 << "   norm:          " << norm << '\n'
-                 << "   energy (<H0>): " << energy << "\n"
-                 << "   <Hint>:        " << expectation_Hint << "\n\n"
-                 << std::flush;
+    if (argc == 4 && string(argv[2]) == "-restart" && runs.size() > 1)
+        throw runtime_error("Restart one run from a named checkpoint, or all of them with -restart alone.");
+    auto restart_path = [&](const Control_data& run) -> string {
+        if (argc == 4 && string(argv[2]) == "-restart")
+            return argv[3];
+        if (argc == 3 && string(argv[2]) == "-restart")
+            return checkpoint_path(run);
+        return {};
+    };
+
+    // with BATCH_SIZE runs of one gauge are propagated together, as columns of one state matrix
+    const auto batches = batch_runs(runs, control.batch_size);
+    if (control.batch_size > 1 && control.orbitals > 1)
+        throw runtime_error("Batched propagation is for a single orbital, set BATCH_SIZE or ORBITALS to 1.");
+    if (control.batch_size > 1 && argc == 4 && string(argv[2]) == "-restart")
+        throw runtime_error("Batched runs restart from their own checkpoints, use -restart alone.");
+
+    if (runs.size() == 1) {
+        run_propagation(runs.front(), ints, U, state, restart_path(runs.front()), cout);
+    } else {
+        // batches go to a work-stealing pool; the threads are split between the concurrent
+        // batches, which leaves one Eigen thread per batch once there are more batches than threads
+        const int threads = Eigen::nbThreads();
+        const int workers = min(threads, static_cast<int>(batches.size()));
+        Eigen::setNbThreads(max(1, threads / static_cast<int>(batches.size())));
+        cout << " Propagating " << runs.size() << " runs in " << batches.size() << " batches on " << workers
+             << " threads, " << Eigen::nbThreads() << " Eigen thread(s) each\n";
+
+        mutex output;
+        vector<function<void()>> tasks;
+        for (size_t b = 0; b < batches.size(); ++b) {
+            tasks.emplace_back([&, b]() {
+                // OpenMP loops of the run, e.g. in Observables_kernel, get the same share
+                omp_set_num_threads(Eigen::nbThreads());
+
+                const auto& batch = batches[b];
+                string log_path   = batch.front().out_path + "/" + batch.front().job_name + ".log";
+                if (batch.size() > 1)
+                    log_path = control.out_path + "/" + control.job_name + "_batch" + to_string(b) + ".log";
+                ofstream log(log_path);
+                if (!log)
+                    throw runtime_error("Cannot open " + log_path);
+                if (batch.size() == 1)
+                    run_propagation(batch.front(), ints, U, state, restart_path(batch.front()), log);
+                else
+                    run_batched_propagation(batch, ints, U, state.col(0), argc == 3 && string(argv[2]) == "-restart",
+                                            log);
+
+                lock_guard<mutex> guard(output);
+                for (const auto& run : batch)
+                    cout << " Finished " << run.job_name << ", log in " << log_path << '\n';
+                cout << std::flush;
+            });
         }
+        Task_pool(workers).run(move(tasks));
+        Eigen::setNbThreads(threads);
+        cout << '\n';
     }
 
-    cout << " ============= END OF TIME PROPAGATION ==============\n";
-
-    write_result(control, res);
+    if (control.orientations > 0) {
+        write_orientation_averages(control, runs);
+        cout << " Orientation averages over " << control.orientations << " directions written to "
+             << tagged_file_name(control.out_file, "avg") << " in " << control.out_path << "\n\n";
+    }
 
     cout << " Wall time: " << setprecision(5) << fixed << clk << "\n\n";
     return EXIT_SUCCESS;
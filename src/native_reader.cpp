@@ -0,0 +1,153 @@
+#include "native_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <complex>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "procedures.h"
+#include "utils.h"
+
+static constexpr int native_slots[] = {
+    Integrals_reader::S_slot,     Integrals_reader::H_slot,     Integrals_reader::Dipx_slot,
+    Integrals_reader::Dipy_slot,  Integrals_reader::Dipz_slot,  Integrals_reader::Gradx_slot,
+    Integrals_reader::Grady_slot, Integrals_reader::Gradz_slot, Integrals_reader::CAP_slot};
+
+static constexpr std::size_t native_alignment = 64;
+
+std::string native_integrals_path(const Control_data &control) {
+    return control.resources_path + "/" + control.file1E + ".ptd";
+}
+
+std::uint64_t basis_hash(const Control_data &control) {
+    std::ostringstream ss;
+    ss << control.representation << '\n' << control.basis;
+    const std::string text = ss.str();
+    return hash_bytes(text.data(), text.size());
+}
+
+Native_reader::Native_reader(const Control_data &control) : _path(native_integrals_path(control)) {
+    const int fd = open(_path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Unable to open native integrals file: " + _path);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(Native_header)) {
+        close(fd);
+        throw std::runtime_error("Native integrals file is truncated: " + _path);
+    }
+    _size = st.st_size;
+
+    void *map = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        throw std::runtime_error("Unable to map native integrals file: " + _path);
+    _data = static_cast<const unsigned char *>(map);
+
+    std::memcpy(&_header, _data, sizeof(Native_header));
+    const Native_header expected;
+    const std::size_t n = get_basis_functions_count(control);
+
+    std::string error;
+    if (std::memcmp(_header.magic, expected.magic, sizeof(expected.magic)) != 0 || _header.version != expected.version)
+        error = "not a native integrals file of version " + std::to_string(expected.version);
+    else if (_header.basis_size != n)
+        error = "basis size " + std::to_string(_header.basis_size) + " does not match " + std::to_string(n);
+    else if (_header.representation != static_cast<std::uint32_t>(control.representation))
+        error = "representation does not match";
+    else if (_header.basis_hash != basis_hash(control))
+        error = "it was computed for a different basis";
+    else if (_header.slot_count > Native_header::max_slots)
+        error = "corrupted slot map";
+    for (std::uint32_t i = 0; error.empty() && i < _header.slot_count; ++i) {
+        if (_header.slots[i].offset + n * n * sizeof(std::complex<double>) > _size)
+            error = "file is truncated";
+    }
+
+    if (!error.empty()) {
+        munmap(const_cast<unsigned char *>(_data), _size);
+        _data = nullptr;
+        throw std::runtime_error("Invalid native integrals file " + _path + ": " + error + ".");
+    }
+}
+
+Native_reader::~Native_reader() {
+    if (_data)
+        munmap(const_cast<unsigned char *>(_data), _size);
+}
+
+Eigen::MatrixXcd Native_reader::load_matrix1E_bin(const int &position) const {
+    for (std::uint32_t i = 0; i < _header.slot_count; ++i) {
+        const auto &slot = _header.slots[i];
+        if (slot.xgtopw_slot != position)
+            continue;
+
+        const std::size_t n     = _header.basis_size;
+        const std::size_t bytes = n * n * sizeof(std::complex<double>);
+        if (hash_bytes(_data + slot.offset, bytes) != slot.checksum)
+            throw std::runtime_error("Checksum mismatch of slot " + std::to_string(position) + " in " + _path + ".");
+
+        return Eigen::Map<const Eigen::MatrixXcd>(reinterpret_cast<const std::complex<double> *>(_data + slot.offset),
+                                                  n, n);
+    }
+    throw std::runtime_error("Slot " + std::to_string(position) + " is not stored in " + _path + ".");
+}
+
+void convert_to_native(const Control_data &control) {
+    const int n = get_basis_functions_count(control);
+    const Disk_reader reader(n, control.resources_path + "/" + control.file1E);
+
+    const std::string path     = native_integrals_path(control);
+    const std::string tmp_path = path + ".tmp";
+    std::ofstream file(tmp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        throw std::runtime_error("Cannot open native integrals file: " + tmp_path);
+
+    Native_header header;
+    header.basis_size     = n;
+    header.representation = static_cast<std::uint32_t>(control.representation);
+    header.basis_hash     = basis_hash(control);
+    header.slot_count     = sizeof(native_slots) / sizeof(native_slots[0]);
+
+    const std::size_t bytes = static_cast<std::size_t>(n) * n * sizeof(std::complex<double>);
+    const auto align        = [](const std::size_t &x) {
+        return (x + native_alignment - 1) / native_alignment * native_alignment;
+    };
+
+    std::size_t offset = align(sizeof(Native_header));
+    for (std::uint32_t i = 0; i < header.slot_count; ++i) {
+        header.slots[i].xgtopw_slot = native_slots[i];
+        header.slots[i].offset      = offset;
+        offset                      = align(offset + bytes);
+    }
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    Eigen::MatrixXcd ints(n, n);
+    for (std::uint32_t i = 0; i < header.slot_count; ++i) {
+        ints.real() = reader.real_plane(native_slots[i]);
+        ints.imag() = reader.imag_plane(native_slots[i]);
+
+        header.slots[i].checksum = hash_bytes(ints.data(), bytes);
+        file.seekp(header.slots[i].offset);
+        file.write(reinterpret_cast<const char *>(ints.data()), bytes);
+        std::cout << "   Converted slot " << native_slots[i] << ".\n";
+    }
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.close();
+    if (!file)
+        throw std::runtime_error("Writing native integrals file failed: " + tmp_path);
+
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("Cannot rename native integrals file to " + path);
+}
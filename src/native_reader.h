@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <eigen3/Eigen/Dense>
+
+#include "control_data.h"
+#include "disk_reader.h"
+
+// Native integrals file written once from the xgtopw one by convert_to_native. Layout:
+//   Native_header                   magic, version, basis size, representation, basis hash, slot map
+//   matrices (64 byte aligned)      interleaved complex, column-major, exactly as Eigen::MatrixXcd
+// Every slot carries its xgtopw position and a checksum of its data, which is verified when
+// the slot is loaded. The file is memory mapped and a load is a single copy.
+struct Native_slot {
+    std::int32_t xgtopw_slot{-1};
+    std::int32_t reserved{0};
+    std::uint64_t offset{0};
+    std::uint64_t checksum{0};
+};
+
+struct Native_header {
+    static constexpr int max_slots = Disk_reader::matrices1E_number;
+
+    char magic[8]{'P', 'T', 'D', 'I', 'N', 'T', 0, 0};
+    std::uint32_t version{2};
+    std::uint32_t basis_size{0};
+    std::uint32_t representation{0};
+    std::uint32_t slot_count{0};
+    std::uint64_t basis_hash{0};
+    Native_slot slots[max_slots]{};
+};
+
+class Native_reader : public Integrals_reader {
+   public:
+    explicit Native_reader(const Control_data &control);
+    ~Native_reader();
+
+    Native_reader(const Native_reader &) = delete;
+    Native_reader &operator=(const Native_reader &) = delete;
+
+   protected:
+    Eigen::MatrixXcd load_matrix1E_bin(const int &position) const override;
+
+   private:
+    const std::string _path;
+    const unsigned char *_data{nullptr};
+    std::size_t _size{0};
+    Native_header _header{};
+};
+
+std::string native_integrals_path(const Control_data &control);
+
+std::uint64_t basis_hash(const Control_data &control);
+
+// converts the xgtopw 1E file of control into the native format, next to it
+void convert_to_native(const Control_data &control);
@@ -0,0 +1,88 @@
+#include "observables.h"
+
+#include <cmath>
+#include <complex>
+
+using namespace std;
+using namespace Eigen;
+
+Observables_kernel::Observables_kernel(const Control_data& control,
+                                       const Integrals& ints,
+                                       const Interaction& interaction)
+    : _gauge(control.gauge),
+      _velocity(control.velocity_dipole),
+      _ints(ints),
+      _interaction(interaction),
+      _S_diagonal(ints.S.isDiagonal(0.0)) {}
+
+Observables Observables_kernel::compute(const double& time, const VectorXcd& state) const {
+    const bool need_G = _velocity || _gauge != Gauge::length;
+
+    vector<const MatrixXcd*> ops = {&_ints.H, &_ints.Dx, &_ints.Dy, &_ints.Dz};
+    if (need_G)
+        ops.insert(ops.end(), {&_ints.Gx, &_ints.Gy, &_ints.Gz});
+    if (!_S_diagonal)
+        ops.push_back(&_ints.S);
+
+    const Index n = state.size();
+    const int K   = ops.size();
+
+    // <state|O|state> = sum_j state_j (state^+ O_{:,j})
+    VectorXcd expect = VectorXcd::Zero(K);
+#pragma omp parallel
+    {
+        VectorXcd local = VectorXcd::Zero(K);
+#pragma omp for schedule(static) nowait
+        for (Index j = 0; j < n; ++j) {
+            for (int k = 0; k < K; ++k)
+                local(k) += state(j) * state.dot(ops[k]->col(j));
+        }
+#pragma omp critical
+        expect += local;
+    }
+
+    const double S_expect =
+        _S_diagonal ? state.cwiseAbs2().dot(_ints.S.diagonal().real()) : expect(K - 1).real();
+
+    Observables res;
+    res.time   = time;
+    res.norm   = sqrt(S_expect);
+    res.energy = expect(0).real() / S_expect;
+    res.dipole << expect(1).real(), expect(2).real(), expect(3).real();
+    if (_velocity)
+        res.velocity << (-1.0i * expect(4)).real(), (-1.0i * expect(5)).real(), (-1.0i * expect(6)).real();
+
+    const Vector3cd field = _interaction.field(time);
+    switch (_gauge) {
+        case Gauge::length:
+            res.hint = (field(0) * expect(1) + field(1) * expect(2) + field(2) * expect(3)).real() / S_expect;
+            break;
+        case Gauge::velocity:
+            res.hint = (-1.0i * (field(0) * expect(4) + field(1) * expect(5) + field(2) * expect(6))).real() / S_expect;
+            break;
+        default:
+            res.hint = (-1.0i * (field(0) * expect(4) + field(1) * expect(5) + field(2) * expect(6))).real() / S_expect +
+                       field.squaredNorm() / 2.0;
+            break;
+    }
+    return res;
+}
+
+Observables Observables_kernel::compute_block(const double& time, const MatrixXcd& states) const {
+    if (states.cols() == 1)
+        return compute(time, states.col(0));
+
+    Observables res;
+    res.time          = time;
+    double population = 0.0;
+    for (Index k = 0; k < states.cols(); ++k) {
+        const auto orbital = compute(time, states.col(k));
+        res.dipole += orbital.dipole;
+        res.velocity += orbital.velocity;
+        res.energy += orbital.energy;
+        res.hint += orbital.hint;
+        population += orbital.norm * orbital.norm;
+    }
+    res.norm = sqrt(population);
+    return res;
+}
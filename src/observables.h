@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include <eigen3/Eigen/Dense>
+
+#include "control_data.h"
+#include "interaction.h"
+#include "procedures.h"
+
+struct Observables {
+    double time{0.0};
+    Eigen::Vector3d dipole{0.0, 0.0, 0.0};
+    double norm{0.0};
+    double energy{0.0};  // <H0> / norm^2
+    double hint{0.0};    // <Hint> / norm^2
+    Eigen::Vector3d velocity{0.0, 0.0, 0.0};  // velocity form dipole -i<G>, if requested
+};
+
+// Evaluates all expectation values in one pass over the operator matrices: every column of
+// S, H, D (and G when needed) is streamed once, without N-sized temporaries. <Hint> follows
+// from <D> or <G> since H_int is linear in them, so H_int(t) is never formed.
+class Observables_kernel {
+   public:
+    Observables_kernel(const Control_data& control, const Integrals& ints, const Interaction& interaction);
+
+    Observables compute(const double& time, const Eigen::VectorXcd& state) const;
+    // summed over the orbitals in the columns of states: dipoles, energies and <Hint> add up,
+    // norm is the square root of the total population
+    Observables compute_block(const double& time, const Eigen::MatrixXcd& states) const;
+
+   private:
+    const Gauge _gauge;
+    const bool _velocity;
+    const Integrals& _ints;
+    const Interaction& _interaction;
+    bool _S_diagonal{false};
+};
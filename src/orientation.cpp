@@ -0,0 +1,157 @@
+#include "orientation.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include "observables.h"
+#include "propagation.h"
+#include "results_writer.h"
+
+using namespace std;
+using namespace Eigen;
+
+namespace {
+
+// octahedral orbits of the Lebedev-Laikov grids: a1 (1, 0, 0), a2 (0, 1, 1) / sqrt(2),
+// a3 (1, 1, 1) / sqrt(3), b (a, a, sqrt(1 - 2 a^2)) and c (a, sqrt(1 - a^2), 0)
+struct Orbit {
+    char type;
+    double a;
+    double weight;
+};
+
+// all distinct sign changes and permutations of generator
+void add_orbit(vector<Orientation>& grid, const Vector3d& generator, const double& weight) {
+    const size_t first = grid.size();
+    array<int, 3> p{0, 1, 2};
+    do {
+        for (int signs = 0; signs < 8; ++signs) {
+            Vector3d n;
+            for (int c = 0; c < 3; ++c)
+                n(c) = ((signs >> c) & 1 ? -1.0 : 1.0) * generator(p[c]);
+            if (none_of(grid.begin() + first, grid.end(), [&](const Orientation& o) { return o.direction == n; }))
+                grid.push_back({n, weight});
+        }
+    } while (next_permutation(p.begin(), p.end()));
+}
+
+vector<Orbit> lebedev_orbits(const int& points) {
+    switch (points) {
+        case 6:
+            return {{'1', 0.0, 1.0 / 6.0}};
+        case 14:
+            return {{'1', 0.0, 1.0 / 15.0}, {'3', 0.0, 3.0 / 40.0}};
+        case 26:
+            return {{'1', 0.0, 1.0 / 21.0}, {'2', 0.0, 4.0 / 105.0}, {'3', 0.0, 9.0 / 280.0}};
+        case 38:
+            return {{'1', 0.0, 1.0 / 105.0}, {'3', 0.0, 9.0 / 280.0}, {'c', 0.4597008433809831, 1.0 / 35.0}};
+        case 50:
+            return {{'1', 0.0, 4.0 / 315.0},
+                    {'2', 0.0, 64.0 / 2835.0},
+                    {'3', 0.0, 27.0 / 1280.0},
+                    {'b', 0.3015113445777636, 14641.0 / 725760.0}};
+        case 74:
+            return {{'1', 0.0, 0.5130671797338464e-3},
+                    {'2', 0.0, 0.1660406956574204e-1},
+                    {'3', 0.0, -0.2958603896103896e-1},
+                    {'b', 0.4803844614152614, 0.2657620708215946e-1},
+                    {'c', 0.3207726489807764, 0.1652217099371571e-1}};
+        case 86:
+            return {{'1', 0.0, 0.1154401154401154e-1},
+                    {'3', 0.0, 0.1194390908585628e-1},
+                    {'b', 0.3696028464541502, 0.1111055571060340e-1},
+                    {'b', 0.6943540066026664, 0.1187650129453714e-1},
+                    {'c', 0.3742430390903412, 0.1181230374690448e-1}};
+        case 110:
+            return {{'1', 0.0, 0.3828270494937162e-2},
+                    {'3', 0.0, 0.9793737512487512e-2},
+                    {'b', 0.1851156353447362, 0.8211737283191111e-2},
+                    {'b', 0.6904210483822922, 0.9942814891178103e-2},
+                    {'b', 0.3956894730559419, 0.9595471336070963e-2},
+                    {'c', 0.4783690288121502, 0.9694996361663028e-2}};
+        default:
+            throw runtime_error("No Lebedev grid with " + to_string(points) +
+                                " points, use 6, 14, 26, 38, 50, 74, 86 or 110.");
+    }
+}
+
+}  // namespace
+
+vector<Orientation> lebedev_grid(const int& points) {
+    vector<Orientation> grid;
+    for (const auto& orbit : lebedev_orbits(points)) {
+        const double a = orbit.a;
+        switch (orbit.type) {
+            case '1':
+                add_orbit(grid, Vector3d(1.0, 0.0, 0.0), orbit.weight);
+                break;
+            case '2':
+                add_orbit(grid, Vector3d(0.0, 1.0, 1.0) / sqrt(2.0), orbit.weight);
+                break;
+            case '3':
+                add_orbit(grid, Vector3d(1.0, 1.0, 1.0) / sqrt(3.0), orbit.weight);
+                break;
+            case 'b':
+                add_orbit(grid, Vector3d(a, a, sqrt(1.0 - 2.0 * a * a)), orbit.weight);
+                break;
+            case 'c':
+                add_orbit(grid, Vector3d(a, sqrt(1.0 - a * a), 0.0), orbit.weight);
+                break;
+        }
+    }
+    return grid;
+}
+
+void write_orientation_averages(const Control_data& control, const vector<Control_data>& runs) {
+    const auto grid = lebedev_grid(control.orientations);
+    for (const auto& gauge : control.gauges) {
+        vector<Observables> average;
+        size_t used = 0;
+        for (const auto& run : runs) {
+            if (run.gauge != gauge)
+                continue;
+            const auto orientation = find_if(grid.begin(), grid.end(),
+                                             [&](const Orientation& o) { return o.direction == run.opt_fielddir; });
+            if (orientation == grid.end())
+                throw runtime_error("Field direction of " + run.job_name + " is not on the orientation grid.");
+
+            const auto samples = read_results(run.out_path + "/" + run.out_file);
+            if (used == 0) {
+                average.resize(samples.size());
+                for (size_t i = 0; i < samples.size(); ++i)
+                    average[i].time = samples[i].time;
+            } else if (samples.size() != average.size()) {
+                throw runtime_error("Results of " + run.job_name + " differ in length from the other orientations.");
+            }
+
+            const double w   = orientation->weight;
+            const Vector3d n = orientation->direction;
+            for (size_t i = 0; i < samples.size(); ++i) {
+                average[i].dipole(2) += w * samples[i].dipole.dot(n);
+                average[i].velocity(2) += w * samples[i].velocity.dot(n);
+                average[i].norm += w * samples[i].norm;
+                average[i].energy += w * samples[i].energy;
+                average[i].hint += w * samples[i].hint;
+            }
+            ++used;
+        }
+        if (used != grid.size())
+            throw runtime_error("Orientation average needs all " + to_string(grid.size()) + " directions.");
+
+        Control_data averaged = control;
+        averaged.gauge        = gauge;
+        averaged.gauges       = {gauge};
+        averaged.opt_fielddir = Vector3d(0.0, 0.0, 1.0);
+        averaged.out_file     = tagged_file_name(control.out_file, "avg");
+        if (control.gauges.size() > 1)
+            averaged.out_file = tagged_file_name(averaged.out_file, gauge_suffix(gauge));
+
+        Results_writer results(averaged);
+        for (const auto& obs : average)
+            results.append(obs);
+        results.close();
+    }
+}
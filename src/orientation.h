@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+
+#include <eigen3/Eigen/Dense>
+
+#include "control_data.h"
+
+// field direction of one molecular orientation and its quadrature weight, weights sum to 1
+struct Orientation {
+    Eigen::Vector3d direction{0.0, 0.0, 1.0};
+    double weight{1.0};
+};
+
+// Lebedev-Laikov grid on the unit sphere with 6, 14, 26, 38, 50, 74, 86 or 110 points,
+// exact for polynomials up to degree 3, 5, 7, 9, 11, 13, 15 and 17
+std::vector<Orientation> lebedev_grid(const int& points);
+
+// Orientation averages of the runs of an ORIENTATIONS grid, read back from their results files:
+// OUT_FILE with the suffix _avg, and the gauge suffix with several gauges. The averaged response
+// is written in the frame of the field, which points along z: dipz and velz are the weighted
+// averages of the components along the field direction, the perpendicular components vanish for
+// randomly aligned molecules and are written as zeros. Norm, energy and <Hint> are averaged as is.
+void write_orientation_averages(const Control_data& control, const std::vector<Control_data>& runs);
@@ -1,37 +1,84 @@
 
 #include "procedures.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <string>
 
 #include "disk_reader.h"
+#include "native_reader.h"
 #include "utils.h"
 
 using namespace std;
 using namespace Eigen;
 
-void write_result(const Control_data& control, const vector<tuple<double, Vector3d, double, double, double>>& res) {
-    if (control.write) {
-        const string res_path = control.out_path + "/" + control.out_file;
-
-        ofstream outfile(res_path);
-        outfile << scientific;
-        outfile << control;
-        outfile << "#        time             dipx          dipy          dipz          norm        energy        <Hint>\n";
-
-        for (const auto& x : res) {
-            outfile << setprecision(5) << setw(13) << get<0>(x) << "   ";
-            outfile << setw(14) << get<1>(x)(0) << setw(14) << get<1>(x)(1) << setw(14) << get<1>(x)(2);
-            outfile << setw(14) << get<2>(x);
-            outfile << setw(14) << get<3>(x);
-            outfile << setw(14) << get<4>(x) << '\n';
+namespace {
+
+enum class Symmetry { hermitian, antihermitian, general };
+
+Symmetry symmetry_of(const MatrixXcd& X) {
+    const double tolerance = 1.0e-12 * X.norm();
+    if ((X - X.adjoint()).norm() <= tolerance)
+        return Symmetry::hermitian;
+    if ((X + X.adjoint()).norm() <= tolerance)
+        return Symmetry::antihermitian;
+    return Symmetry::general;
+}
+
+// X <- C^+ X C for all operators that are loaded. The operators are taken in chunks: X C is one tall GEMM
+// on the operators of a chunk stacked on top of each other, and the chunk is sized so that its stacked
+// operators and their product with C fit in chunk_budget bytes. Peak memory thus stays at about one
+// operator set plus one chunk. C^+ (X C) is one GEMM per operator, each threaded by Eigen; for
+// (anti-)Hermitian X (H, D, G, CAP) the upper triangle is then mirrored from the lower one.
+void transform_operators(const MatrixXcd& C, vector<MatrixXcd*> operators) {
+    operators.erase(remove_if(operators.begin(), operators.end(), [](const MatrixXcd* X) { return X->size() == 0; }),
+                    operators.end());
+
+    constexpr std::size_t chunk_budget = std::size_t{1} << 30;
+
+    const Index n = C.rows();
+    const Index m = C.cols();
+
+    const std::size_t operator_bytes = static_cast<std::size_t>(n) * (n + m) * sizeof(complex<double>);
+    const Index chunk                = max<Index>(1, chunk_budget / max<std::size_t>(1, operator_bytes));
+
+    for (Index first = 0; first < static_cast<Index>(operators.size()); first += chunk) {
+        const Index k = min(chunk, static_cast<Index>(operators.size()) - first);
+
+        vector<Symmetry> symmetry(k);
+        MatrixXcd stacked(k * n, n);
+        for (Index i = 0; i < k; ++i) {
+            symmetry[i]                  = symmetry_of(*operators[first + i]);
+            stacked.middleRows(i * n, n) = *operators[first + i];
+            operators[first + i]->resize(0, 0);
         }
 
-        outfile.close();
+        MatrixXcd XC(k * n, m);
+        XC.noalias() = stacked * C;
+        stacked.resize(0, 0);
+
+        for (Index i = 0; i < k; ++i) {
+            MatrixXcd& X = *operators[first + i];
+            X.noalias() = C.adjoint() * XC.middleRows(i * n, n);
+            if (symmetry[i] == Symmetry::general)
+                continue;
+
+            const double sign = symmetry[i] == Symmetry::hermitian ? 1.0 : -1.0;
+            for (Index col = 0; col < m; ++col) {
+                X(col, col) = symmetry[i] == Symmetry::hermitian ? complex<double>(X(col, col).real(), 0.0)
+                                                                 : complex<double>(0.0, X(col, col).imag());
+                for (Index row = col + 1; row < m; ++row)
+                    X(col, row) = sign * conj(X(row, col));
+            }
+        }
     }
 }
 
+}  // namespace
+
 void run_preparation(const Control_data& control) {
     const string xgtopw_input_path = control.job_name + ".inp";
     ofstream outfile(xgtopw_input_path);
@@ -44,17 +91,29 @@ void run_preparation(const Control_data& control) {
 }
 
 void Integrals::read_from_disk(const Control_data& control) {
-    Disk_reader reader(get_basis_functions_count(control), control.resources_path + "/" + control.file1E);
-
-    S   = reader.load_S();
-    H   = reader.load_H();
-    Dx  = reader.load_Dipx();
-    Dy  = reader.load_Dipy();
-    Dz  = reader.load_Dipz();
-    CAP = reader.load_CAP();
-    Gx  = reader.load_Gradx();
-    Gy  = reader.load_Grady();
-    Gz  = reader.load_Gradz();
+    unique_ptr<Integrals_reader> reader;
+    switch (control.integrals_format) {
+        case Integrals_format::xgtopw:
+            reader = make_unique<Disk_reader>(get_basis_functions_count(control),
+                                              control.resources_path + "/" + control.file1E);
+            break;
+        case Integrals_format::native:
+            reader = make_unique<Native_reader>(control);
+            break;
+    }
+
+    S  = reader->load_S();
+    H  = reader->load_H();
+    Dx = reader->load_Dipx();
+    Dy = reader->load_Dipy();
+    Dz = reader->load_Dipz();
+    if (control.use_cap)
+        CAP = reader->load_CAP();
+    if (gradient_required(control)) {
+        Gx = reader->load_Gradx();
+        Gy = reader->load_Grady();
+        Gz = reader->load_Gradz();
+    }
 }
 
 MatrixXcd Integrals::cut_linear_dependencies() {
@@ -81,15 +140,14 @@ MatrixXcd Integrals::cut_linear_dependencies() {
     cout << "   Transformation matrix:\n" << U << "\n\n";
 #endif
 
-    H   = U.adjoint() * H * U;
-    S   = es.eigenvalues().tail(es.eigenvalues().size() - vecs_to_cut).asDiagonal();
-    Dx  = U.adjoint() * Dx * U;
-    Dy  = U.adjoint() * Dy * U;
-    Dz  = U.adjoint() * Dz * U;
-    Gx  = U.adjoint() * Gx * U;
-    Gy  = U.adjoint() * Gy * U;
-    Gz  = U.adjoint() * Gz * U;
-    CAP = U.adjoint() * CAP * U;
+    transform_operators(U, {&H, &Dx, &Dy, &Dz, &Gx, &Gy, &Gz, &CAP});
+    S = es.eigenvalues().tail(es.eigenvalues().size() - vecs_to_cut).asDiagonal();
 
     return U;
 }
+
+void Integrals::transform_to_eigenbasis(const VectorXd& energies, const MatrixXcd& C) {
+    H   = energies.cast<complex<double>>().asDiagonal();
+    S   = MatrixXcd::Identity(C.cols(), C.cols());
+    transform_operators(C, {&Dx, &Dy, &Dz, &Gx, &Gy, &Gz, &CAP});
+}
@@ -20,10 +20,10 @@ inline int get_basis_functions_count(const Control_data& data) {
     }
 }
 
-void write_result(const Control_data& control, const std::vector<std::tuple<double, Eigen::Vector3d, double, double, double>>& res);
-
 void run_preparation(const Control_data& control);
 
+// Operators of the run. G is loaded only when the gauge or VELOCITY_DIPOLE needs it and CAP only
+// with USE_CAP; the others stay empty and are skipped by all transformations.
 struct Integrals {
     Eigen::MatrixXcd S{};
     Eigen::MatrixXcd H{};
@@ -31,6 +31,20 @@ struct Integrals {
     Eigen::MatrixXcd Gx{}, Gy{}, Gz{};
     Eigen::MatrixXcd CAP{};
 
+    static bool gradient_required(const Control_data& control) {
+        for (const auto& gauge : control.gauges)
+            if (gauge != Gauge::length)
+                return true;
+        return control.velocity_dipole;
+    }
+    bool has_gradient() const { return Gx.size() > 0; }
+    bool has_cap() const { return CAP.size() > 0; }
+
+    // H + CAP, or H without CAP
+    Eigen::MatrixXcd field_free_hamiltonian() const { return has_cap() ? Eigen::MatrixXcd(H + CAP) : H; }
+
     void read_from_disk(const Control_data& control);
     Eigen::MatrixXcd cut_linear_dependencies();
+    // moves all operators to the S-orthonormal eigenvectors C of H with eigenvalues energies
+    void transform_to_eigenbasis(const Eigen::VectorXd& energies, const Eigen::MatrixXcd& C);
 };
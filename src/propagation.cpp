@@ -0,0 +1,513 @@
+#include "propagation.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <stdexcept>
+
+#include "adaptive.h"
+#include "checkpoint.h"
+#include "dump_writer.h"
+#include "interaction.h"
+#include "observables.h"
+#include "orientation.h"
+#include "propagators.h"
+#include "results_writer.h"
+
+using namespace std;
+using namespace Eigen;
+
+void run_propagation(const Control_data& control,
+                     const Integrals& ints,
+                     const MatrixXcd& U,
+                     const MatrixXcd& initial_states,
+                     const string& restart_path,
+                     ostream& log) {
+    log << scientific;
+
+    const Interaction interaction(control, ints);
+    const MatrixXcd H0 = ints.field_free_hamiltonian();
+
+    unique_ptr<Time_propagator> propagator;
+    switch (control.propagator) {
+        case Propagator::crank_nicolson:
+            propagator = make_unique<Crank_nicolson>(ints.S, H0, interaction);
+            break;
+        case Propagator::crank_nicolson_pencil:
+            if (control.adaptive_dt)
+                throw runtime_error("Pencil propagation is diagonalized for fixed DT, it cannot be adaptive.");
+            propagator = make_unique<Crank_nicolson_pencil>(ints.S, H0, interaction, control.dt, log);
+            break;
+        case Propagator::rk4:
+            propagator = make_unique<Runge_kutta4>(ints.S, H0, interaction);
+            break;
+        case Propagator::rk45:
+            propagator = make_unique<Runge_kutta45>(ints.S, H0, interaction, control.propagator_tol);
+            break;
+        case Propagator::short_iterative_arnoldi:
+            propagator = make_unique<Short_iterative_arnoldi>(ints.S, H0, interaction, control.krylov_dim);
+            break;
+        case Propagator::krylov:
+            propagator =
+                make_unique<Krylov_propagator>(ints.S, H0, interaction, control.krylov_dim, control.propagator_tol);
+            break;
+        case Propagator::interaction_picture:
+            propagator = make_unique<Interaction_picture>(ints.S, ints.H, ints.CAP, interaction);
+            break;
+        case Propagator::cfet4:
+        case Propagator::cfet6: {
+            unique_ptr<Exponential_backend> backend;
+            switch (control.exponential) {
+                case Exponential::pade:
+                    backend = make_unique<Pade_backend>(ints.S, H0, interaction);
+                    break;
+                case Exponential::krylov:
+                    backend = make_unique<Krylov_backend>(ints.S, H0, interaction, control.krylov_dim,
+                                                          control.propagator_tol);
+                    break;
+            }
+            propagator = make_unique<Commutator_free_magnus>(control.propagator == Propagator::cfet4 ? 4 : 6,
+                                                             move(backend));
+            break;
+        }
+    }
+
+    const Observables_kernel observables(control, ints, interaction);
+    // one orbital per column; dumps and checkpoints keep the columns one after another
+    MatrixXcd state = initial_states;
+    auto flat       = [](const MatrixXcd& states) {
+        return VectorXcd(Map<const VectorXcd>(states.data(), states.size()));
+    };
+
+    // checkpoints are tied to the settings and to the operators the propagation runs with
+    Checkpoint_policy checkpoints(control);
+    const bool restart          = !restart_path.empty();
+    std::uint64_t control_key   = 0;
+    std::uint64_t integrals_key = 0;
+    if (checkpoints.enabled() || restart) {
+        control_key   = control_hash(control);
+        integrals_key = integrals_hash(ints, U);
+    }
+
+    Checkpoint resumed;
+    if (restart) {
+        resumed = load_checkpoint(restart_path, control_key, integrals_key);
+        log << " Restarting from " << restart_path << " at step " << resumed.step << ", time " << resumed.time
+            << "\n\n";
+    }
+
+    unique_ptr<Results_writer> results;
+    if (control.write)
+        results = make_unique<Results_writer>(control, resumed.results_size);
+
+    unique_ptr<Dump_writer> dumps;
+    if (control.dump)
+        dumps = make_unique<Dump_writer>(control, U, resumed.dumps);
+
+    auto save = [&](const int& i, const int& registered, const double& time, const double& step_size) {
+        const Checkpoint checkpoint{i,
+                                    registered,
+                                    time,
+                                    step_size,
+                                    flat(state),
+                                    results ? results->synchronize() : 0,
+                                    dumps ? dumps->synchronize() : vector<Dump_index_entry>{}};
+        save_checkpoint(checkpoint_path(control), control_key, integrals_key, checkpoint);
+        log << " Checkpoint at step " << i << " written to " << checkpoint_path(control) << "\n\n";
+    };
+
+    auto register_state = [&](const int& i, const double& time, const MatrixXcd& state) {
+        const auto obs = observables.compute_block(time, state);
+
+        if (dumps)
+            dumps->push(i, time, flat(state));
+        if (results)
+            results->append(obs);
+        log << " Iteration: " << i << " , time: " << time << '\n'
+            << "   dipole moment: " << obs.dipole.transpose() << '\n';
+        if (control.velocity_dipole)
+            log << "   velocity form: " << obs.velocity.transpose() << '\n';
+        log << "   norm:          " << obs.norm << '\n'
+            << "   energy (<H0>): " << obs.energy << "\n"
+            << "   <Hint>:        " << obs.hint << "\n\n"
+            << std::flush;
+    };
+
+    log << " ================= TIME PROPAGATION =================\n";
+    double current_time = 0.0;
+    if (restart) {
+        if (resumed.state.size() != state.size())
+            throw runtime_error("Checkpoint holds a different number of orbitals: " + restart_path);
+        current_time = resumed.time;
+        state        = Map<const MatrixXcd>(resumed.state.data(), state.rows(), state.cols());
+    }
+    if (!restart)
+        register_state(0, current_time, state);
+
+    // with ANALYTIC_FIELD_FREE the time independent tail after the pulse is evaluated in
+    // closed form in the eigenbasis of H0 instead of being propagated
+    if (control.adaptive_dt) {
+        Step_controller controller(*propagator, ints.S, interaction, control);
+        if (restart)
+            controller.set_step_size(resumed.step_size);
+
+        // observables on the REGISTER_DIPOLE_DT grid come from the dense output of the
+        // propagator: a side step from the last accepted state to the grid point
+        int registered = restart ? resumed.registered : 1;
+        int i          = restart ? resumed.step + 1 : 1;
+        for (; registered * control.register_dip <= control.max_t * (1.0 + 1.0e-12); ++i) {
+            if (control.analytic_field_free && current_time >= interaction.pulse_end())
+                break;
+
+            const MatrixXcd previous   = state;
+            const double previous_time = current_time;
+            current_time += controller.step(state, current_time, control.max_t);
+
+            for (; registered * control.register_dip <= current_time * (1.0 + 1.0e-12); ++registered) {
+                const double register_time = registered * control.register_dip;
+                if (abs(register_time - current_time) <= 1.0e-12 * current_time) {
+                    register_state(i, current_time, state);
+                } else {
+                    MatrixXcd dense = previous;
+                    propagator->step_block(dense, previous_time, register_time - previous_time);
+                    register_state(i, register_time, dense);
+                }
+            }
+
+            if (checkpoints.due(i))
+                save(i, registered, current_time, controller.step_size());
+        }
+
+        if (registered * control.register_dip <= control.max_t * (1.0 + 1.0e-12)) {
+            const Field_free_propagator field_free(ints.S, H0, log);
+            const MatrixXcd coefficients = field_free.to_eigenbasis(state);
+            const double pulse_end       = current_time;
+
+            for (; registered * control.register_dip <= control.max_t * (1.0 + 1.0e-12); ++registered) {
+                const double register_time = registered * control.register_dip;
+                register_state(i, register_time, field_free.from_eigenbasis(coefficients, register_time - pulse_end));
+            }
+        }
+        log << " ============= END OF TIME PROPAGATION ==============\n";
+
+        controller.print_statistics(log);
+    } else {
+        const int steps             = std::round(control.max_t / control.dt);
+        const int register_interval = std::round(control.register_dip / control.dt);
+
+        int i = restart ? resumed.step + 1 : 1;
+        for (; i <= steps; ++i) {
+            if (control.analytic_field_free && current_time >= interaction.pulse_end())
+                break;
+
+            propagator->step_block(state, current_time, control.dt);
+            current_time += control.dt;
+
+            if (i % register_interval == 0)
+                register_state(i, current_time, state);
+            if (checkpoints.due(i))
+                save(i, 0, current_time, control.dt);
+        }
+
+        if (i <= steps) {
+            const Field_free_propagator field_free(ints.S, H0, log);
+            const MatrixXcd coefficients = field_free.to_eigenbasis(state);
+            const int pulse_end_step     = i - 1;
+
+            for (; i <= steps; ++i) {
+                if (i % register_interval == 0)
+                    register_state(i, current_time + (i - pulse_end_step) * control.dt,
+                                   field_free.from_eigenbasis(coefficients, (i - pulse_end_step) * control.dt));
+            }
+        }
+        log << " ============= END OF TIME PROPAGATION ==============\n";
+    }
+
+    if (dumps)
+        dumps->close();
+
+    propagator->print_statistics(log);
+
+    if (results)
+        results->close();
+}
+
+void run_batched_propagation(const vector<Control_data>& runs,
+                             const Integrals& ints,
+                             const MatrixXcd& U,
+                             const VectorXcd& initial_state,
+                             const bool& restart,
+                             ostream& log) {
+    log << scientific;
+
+    const auto& control = runs.front();
+    if (control.propagator != Propagator::rk4)
+        throw runtime_error("Batched propagation is implemented for PROPAGATOR rk4 only.");
+    if (control.adaptive_dt)
+        throw runtime_error("Batched propagation needs a fixed DT, it cannot be adaptive.");
+
+    const Index K = runs.size();
+    vector<Interaction> interactions;
+    vector<Observables_kernel> observables;
+    interactions.reserve(K);
+    observables.reserve(K);
+    for (Index k = 0; k < K; ++k)
+        interactions.emplace_back(runs[k], ints);
+    for (Index k = 0; k < K; ++k)
+        observables.emplace_back(runs[k], ints, interactions[k]);
+
+    const MatrixXcd H0 = ints.field_free_hamiltonian();
+    const Batched_runge_kutta4 propagator(ints.S, H0, ints, interactions);
+    MatrixXcd states = initial_state.replicate(1, K);
+
+    // every run has its own checkpoint, all of them are written at the same steps
+    Checkpoint_policy checkpoints(control);
+    vector<std::uint64_t> control_keys(K, 0);
+    std::uint64_t integrals_key = 0;
+    if (checkpoints.enabled() || restart) {
+        for (Index k = 0; k < K; ++k)
+            control_keys[k] = control_hash(runs[k]);
+        integrals_key = integrals_hash(ints, U);
+    }
+
+    vector<Checkpoint> resumed(K);
+    if (restart) {
+        for (Index k = 0; k < K; ++k) {
+            resumed[k] = load_checkpoint(checkpoint_path(runs[k]), control_keys[k], integrals_key);
+            if (resumed[k].step != resumed.front().step)
+                throw runtime_error("Checkpoints of one batch are at different steps: " + checkpoint_path(runs[k]));
+            states.col(k) = resumed[k].state;
+        }
+        log << " Restarting " << K << " runs at step " << resumed.front().step << ", time " << resumed.front().time
+            << "\n\n";
+    }
+
+    vector<unique_ptr<Results_writer>> results(K);
+    vector<unique_ptr<Dump_writer>> dumps(K);
+    for (Index k = 0; k < K; ++k) {
+        if (control.write)
+            results[k] = make_unique<Results_writer>(runs[k], resumed[k].results_size);
+        if (control.dump)
+            dumps[k] = make_unique<Dump_writer>(runs[k], U, resumed[k].dumps);
+    }
+
+    auto save = [&](const int& i, const double& time) {
+        for (Index k = 0; k < K; ++k) {
+            const Checkpoint checkpoint{i,
+                                        0,
+                                        time,
+                                        control.dt,
+                                        states.col(k),
+                                        results[k] ? results[k]->synchronize() : 0,
+                                        dumps[k] ? dumps[k]->synchronize() : vector<Dump_index_entry>{}};
+            save_checkpoint(checkpoint_path(runs[k]), control_keys[k], integrals_key, checkpoint);
+        }
+        log << " Checkpoints at step " << i << " written\n\n";
+    };
+
+    auto register_states = [&](const int& i, const double& time, const MatrixXcd& states) {
+        log << " Iteration: " << i << " , time: " << time << '\n';
+        for (Index k = 0; k < K; ++k) {
+            const auto obs = observables[k].compute(time, states.col(k));
+
+            if (dumps[k])
+                dumps[k]->push(i, time, states.col(k));
+            if (results[k])
+                results[k]->append(obs);
+            log << "   " << runs[k].job_name << "  dipole moment: " << obs.dipole.transpose() << "  norm: " << obs.norm
+                << '\n';
+        }
+        log << '\n' << std::flush;
+    };
+
+    log << " ============= BATCHED TIME PROPAGATION =============\n";
+    for (const auto& run : runs)
+        log << "   " << run.job_name << '\n';
+    log << '\n';
+
+    double current_time = restart ? resumed.front().time : 0.0;
+    if (!restart)
+        register_states(0, current_time, states);
+
+    // the closed form field-free tail starts once the longest pulse of the batch is over
+    double pulse_end = 0.0;
+    for (const auto& interaction : interactions)
+        pulse_end = max(pulse_end, interaction.pulse_end());
+
+    const int steps             = std::round(control.max_t / control.dt);
+    const int register_interval = std::round(control.register_dip / control.dt);
+
+    int i = restart ? resumed.front().step + 1 : 1;
+    for (; i <= steps; ++i) {
+        if (control.analytic_field_free && current_time >= pulse_end)
+            break;
+
+        propagator.step(states, current_time, control.dt);
+        current_time += control.dt;
+
+        if (i % register_interval == 0)
+            register_states(i, current_time, states);
+        if (checkpoints.due(i))
+            save(i, current_time);
+    }
+
+    if (i <= steps) {
+        const Field_free_propagator field_free(ints.S, H0, log);
+        const MatrixXcd coefficients = field_free.to_eigenbasis(states);
+        const int pulse_end_step     = i - 1;
+
+        for (; i <= steps; ++i) {
+            if (i % register_interval == 0)
+                register_states(i, current_time + (i - pulse_end_step) * control.dt,
+                                field_free.from_eigenbasis(coefficients, (i - pulse_end_step) * control.dt));
+        }
+    }
+    log << " ============= END OF TIME PROPAGATION ==============\n";
+
+    for (Index k = 0; k < K; ++k) {
+        if (dumps[k])
+            dumps[k]->close();
+        if (results[k])
+            results[k]->close();
+    }
+}
+
+string gauge_suffix(const Gauge& gauge) {
+    switch (gauge) {
+        case Gauge::length:
+            return "len";
+        case Gauge::velocity:
+            return "vel";
+        case Gauge::velocity_with_Asqrt:
+            return "velA";
+        case Gauge::acceleration:
+            return "acc";
+    }
+    return "";
+}
+
+namespace {
+
+// files of one run of several: <stem>_<tag>.<ext> results, DUMP_PATH/<tag> dumps and
+// <JOB_NAME>_<tag> for checkpoints and logs
+void tag_run(Control_data& run, const string& tag) {
+    run.out_file = tagged_file_name(run.out_file, tag);
+    run.job_name += "_" + tag;
+    if (run.dump_path.empty() || run.dump_path.back() != '/')
+        run.dump_path += '/';
+    run.dump_path += tag;
+    if (run.dump && mkdir(run.dump_path.c_str(), 0755) != 0 && errno != EEXIST)
+        throw runtime_error("Cannot create dump directory: " + run.dump_path);
+}
+
+}  // namespace
+
+string tagged_file_name(const string& file, const string& tag) {
+    const auto dot = file.rfind('.');
+    return dot == string::npos ? file + "_" + tag : file.substr(0, dot) + "_" + tag + file.substr(dot);
+}
+
+vector<Control_data> gauge_runs(const Control_data& control) {
+    vector<Control_data> runs;
+    for (const auto& gauge : control.gauges) {
+        Control_data run = control;
+        run.gauge        = gauge;
+        run.gauges       = {gauge};
+        if (control.gauges.size() > 1)
+            tag_run(run, gauge_suffix(gauge));
+        runs.push_back(run);
+    }
+    return runs;
+}
+
+vector<Control_data> sweep_points(const Control_data& control) {
+    Sweep sweep = control.sweep;
+    if (control.orientations > 0) {
+        if (!sweep.empty())
+            throw runtime_error("ORIENTATIONS cannot be combined with swept laser parameters.");
+        if (!control.write)
+            throw runtime_error("Orientation averages are computed from the results, set WRITE Y.");
+        for (const auto& orientation : lebedev_grid(control.orientations))
+            sweep.field_direction.push_back(orientation.direction);
+    }
+    if (sweep.empty())
+        return {control};
+
+    auto values = [](const vector<double>& list, const double& value) {
+        return list.empty() ? vector<double>{value} : list;
+    };
+    const auto intensities = values(sweep.intensity, control.opt_intensity);
+    const auto omegas      = values(sweep.omega_eV, control.opt_omega_eV);
+    const auto envelopes   = values(sweep.carrier_envelope, control.opt_carrier_envelope);
+    const auto cycles      = values(sweep.cycles, control.opt_cycles);
+    const auto directions  = sweep.field_direction.empty() ? vector<Vector3d>{control.opt_fielddir}
+                                                           : sweep.field_direction;
+
+    const size_t count = intensities.size() * omegas.size() * envelopes.size() * cycles.size() * directions.size();
+    const size_t width = to_string(count - 1).size();
+
+    vector<Control_data> points;
+    for (const auto& intensity : intensities)
+        for (const auto& omega : omegas)
+            for (const auto& envelope : envelopes)
+                for (const auto& cycle : cycles)
+                    for (const auto& direction : directions) {
+                        Control_data point         = control;
+                        point.sweep                = {};
+                        point.opt_intensity        = intensity;
+                        point.opt_omega_eV         = omega;
+                        point.opt_carrier_envelope = envelope;
+                        point.opt_cycles           = cycle;
+                        point.opt_fielddir         = direction;
+
+                        const string index = to_string(points.size());
+                        tag_run(point, "p" + string(width - index.size(), '0') + index);
+                        points.push_back(point);
+                    }
+    return points;
+}
+
+vector<vector<Control_data>> batch_runs(const vector<Control_data>& runs, const int& size) {
+    if (size < 1)
+        throw runtime_error("BATCH_SIZE must be at least 1.");
+
+    vector<vector<Control_data>> batches;
+    vector<Gauge> gauges;
+    for (const auto& run : runs) {
+        if (find(gauges.begin(), gauges.end(), run.gauge) == gauges.end())
+            gauges.push_back(run.gauge);
+    }
+    for (const auto& gauge : gauges) {
+        for (const auto& run : runs) {
+            if (run.gauge != gauge)
+                continue;
+            const bool full = !batches.empty() && static_cast<int>(batches.back().size()) == size;
+            if (batches.empty() || batches.back().front().gauge != gauge || full)
+                batches.emplace_back();
+            batches.back().push_back(run);
+        }
+    }
+    return batches;
+}
+
+void write_sweep_index(const string& path, const vector<Control_data>& runs) {
+    ofstream file(path);
+    if (!file)
+        throw runtime_error("Cannot open sweep index: " + path);
+
+    file << "# run  job  gauge  OPT_INTENSITY  OPT_OMEGA_EV  OPT_CARRIER_ENVELOPE  OPT_CYCLES  "
+            "OPT_FIELD_DIRECTION(x y z)  results\n";
+    file << setprecision(10);
+    for (size_t r = 0; r < runs.size(); ++r) {
+        const auto& run = runs[r];
+        file << r << "  " << run.job_name << "  " << run.gauge << "  " << run.opt_intensity << "  "
+             << run.opt_omega_eV << "  " << run.opt_carrier_envelope << "  " << run.opt_cycles << "  "
+             << run.opt_fielddir.transpose() << "  " << run.out_path + "/" + run.out_file << '\n';
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <eigen3/Eigen/Dense>
+
+#include "control_data.h"
+#include "procedures.h"
+
+// One time propagation of the orbitals in the columns of initial_states with the operators
+// ints, in the reduced basis given by U. Writes the results, orbital-summed with more than one
+// column, dumps and checkpoints of control; with a non-empty restart_path it continues from that
+// checkpoint. Progress goes to log.
+void run_propagation(const Control_data& control,
+                     const Integrals& ints,
+                     const Eigen::MatrixXcd& U,
+                     const Eigen::MatrixXcd& initial_states,
+                     const std::string& restart_path,
+                     std::ostream& log);
+
+// runs that differ only in their pulses, propagated together with Batched_runge_kutta4. Needs
+// PROPAGATOR rk4 and a fixed DT; every run keeps its own results, dumps and checkpoints, with
+// restart all of them continue from their own checkpoints.
+void run_batched_propagation(const std::vector<Control_data>& runs,
+                             const Integrals& ints,
+                             const Eigen::MatrixXcd& U,
+                             const Eigen::VectorXcd& initial_state,
+                             const bool& restart,
+                             std::ostream& log);
+
+// len, vel, velA, acc; used to name the files of one gauge in multi-gauge runs
+std::string gauge_suffix(const Gauge& gauge);
+
+// one Control_data per gauge in GAUGE. With more than one gauge every run gets its own
+// results file res_<suffix>.out, dump directory DUMP_PATH/<suffix> and job name <JOB_NAME>_<suffix>
+std::vector<Control_data> gauge_runs(const Control_data& control);
+
+// <stem>_<tag>.<ext> of file name
+std::string tagged_file_name(const std::string& file, const std::string& tag);
+
+// one Control_data per point of the laser parameter sweep, the product of all swept OPT_* keys,
+// named like gauge_runs with the suffix p<index>; without a sweep just control. With ORIENTATIONS
+// the points are the directions of the Lebedev grid.
+std::vector<Control_data> sweep_points(const Control_data& control);
+
+// runs of the same gauge in groups of at most size, in the order of runs
+std::vector<std::vector<Control_data>> batch_runs(const std::vector<Control_data>& runs, const int& size);
+
+// text table of the laser parameters, gauge and results file of every run
+void write_sweep_index(const std::string& path, const std::vector<Control_data>& runs);
@@ -0,0 +1,408 @@
+#include "propagators.h"
+
+#include <cmath>
+#include <complex>
+#include <iostream>
+#include <stdexcept>
+
+#include <eigen3/Eigen/Eigenvalues>
+
+#include "utils.h"
+
+using namespace std;
+using namespace Eigen;
+
+void Time_propagator::step_block(MatrixXcd& states, const double& time, const double& dt) {
+    for (Index k = 0; k < states.cols(); ++k) {
+        VectorXcd state = states.col(k);
+        step(state, time, dt);
+        states.col(k) = state;
+    }
+}
+
+Crank_nicolson::Crank_nicolson(const MatrixXcd& S, const MatrixXcd& H0, const Interaction& interaction)
+    : _S(S), _H0(H0), _interaction(interaction) {}
+
+void Crank_nicolson::factorize(const double& time, const double& dt) {
+    const Vector3cd field = _interaction.field(time + dt);
+    if (_cached && dt == _cached_dt && field == _cached_field) {
+        ++_hits;
+    } else {
+        ++_misses;
+        const MatrixXcd H_t = _H0 + _interaction.matrix(time + dt);
+        _A_lu.compute(_S + 1i * dt / 2.0 * H_t);
+        _B            = _S - 1i * dt / 2.0 * H_t;
+        _cached       = true;
+        _cached_dt    = dt;
+        _cached_field = field;
+    }
+}
+
+void Crank_nicolson::step(VectorXcd& state, const double& time, const double& dt) {
+    factorize(time, dt);
+    state = _A_lu.solve(_B * state);
+}
+
+void Crank_nicolson::step_block(MatrixXcd& states, const double& time, const double& dt) {
+    if (states.cols() == 1)
+        return Time_propagator::step_block(states, time, dt);
+
+    factorize(time, dt);
+    states = _A_lu.solve(_B * states);
+}
+
+void Crank_nicolson::print_statistics(ostream& os) const {
+    os << " Crank-Nicolson factorization cache:\n"
+       << "   hits:                     " << _hits << '\n'
+       << "   misses:                   " << _misses << "\n\n";
+}
+
+Crank_nicolson_pencil::Crank_nicolson_pencil(const MatrixXcd& S,
+                                             const MatrixXcd& H0,
+                                             const Interaction& interaction,
+                                             const double& dt,
+                                             ostream& log)
+    : _interaction(interaction), _dt(dt) {
+    log << " Diagonalizing Crank-Nicolson pencil.\n";
+
+    const PartialPivLU<MatrixXcd> M0_lu(S + 1i * dt / 2.0 * H0);
+
+    ComplexEigenSolver<MatrixXcd> es(M0_lu.solve(1i * dt / 2.0 * interaction.coupling()));
+    log << "   EigenSolver info: ";
+    if (check_and_report_eigen_info(log, es.info()))
+        throw runtime_error("Diagonalization of the Crank-Nicolson pencil failed.");
+
+    _X      = es.eigenvectors();
+    _lambda = es.eigenvalues();
+
+    _X_lu.compute(_X);
+    log << "   Reciprocal condition number of eigenvectors: " << _X_lu.rcond() << "\n\n";
+
+    _P = _X_lu.solve(M0_lu.solve(S - 1i * dt / 2.0 * H0));
+}
+
+void Crank_nicolson_pencil::step(VectorXcd& state, const double& time, const double& dt) {
+    if (dt != _dt)
+        throw runtime_error("Crank-Nicolson pencil was diagonalized for a different time step.");
+
+    const double f = _interaction.amplitude(time + dt);
+
+    const VectorXcd y = (_P * state - f * _lambda.cwiseProduct(_X_lu.solve(state))).cwiseQuotient(
+        (VectorXcd::Ones(_lambda.size()) + f * _lambda));
+    state = _X * y;
+}
+
+void Crank_nicolson_pencil::step_block(MatrixXcd& states, const double& time, const double& dt) {
+    if (states.cols() == 1)
+        return Time_propagator::step_block(states, time, dt);
+    if (dt != _dt)
+        throw runtime_error("Crank-Nicolson pencil was diagonalized for a different time step.");
+
+    const double f = _interaction.amplitude(time + dt);
+
+    MatrixXcd y = _P * states - f * _lambda.asDiagonal() * _X_lu.solve(states);
+    y.array().colwise() /= (VectorXcd::Ones(_lambda.size()) + f * _lambda).array();
+    states = _X * y;
+}
+
+Explicit_propagator::Explicit_propagator(const MatrixXcd& S, const MatrixXcd& H0, const Interaction& interaction)
+    : _H0(H0), _interaction(interaction) {
+    if (!S.isDiagonal())
+        throw runtime_error("Explicit propagators require diagonal S, cut linear dependencies first.");
+    _S_diag = S.diagonal().real();
+}
+
+VectorXcd Explicit_propagator::hamiltonian(const double& time, const VectorXcd& state) const {
+    VectorXcd res = _H0 * state;
+    res += _interaction.apply(time, state);
+    return res.cwiseQuotient(_S_diag.cast<complex<double>>());
+}
+
+VectorXcd Explicit_propagator::derivative(const double& time, const VectorXcd& state) const {
+    return -1.0i * hamiltonian(time, state);
+}
+
+double Explicit_propagator::norm(const VectorXcd& state) const {
+    return sqrt(state.cwiseAbs2().dot(_S_diag));
+}
+
+void Runge_kutta4::step(VectorXcd& state, const double& time, const double& dt) {
+    const VectorXcd k1 = derivative(time, state);
+    const VectorXcd k2 = derivative(time + dt / 2.0, state + dt / 2.0 * k1);
+    const VectorXcd k3 = derivative(time + dt / 2.0, state + dt / 2.0 * k2);
+    const VectorXcd k4 = derivative(time + dt, state + dt * k3);
+
+    state += dt / 6.0 * (k1 + 2.0 * k2 + 2.0 * k3 + k4);
+}
+
+Batched_runge_kutta4::Batched_runge_kutta4(const MatrixXcd& S,
+                                           const MatrixXcd& H0,
+                                           const Integrals& ints,
+                                           const vector<Interaction>& interactions)
+    : _H0(H0), _ints(ints), _interactions(interactions) {
+    if (!S.isDiagonal())
+        throw runtime_error("Explicit propagators require diagonal S, cut linear dependencies first.");
+    for (const auto& interaction : interactions) {
+        if (interaction.gauge() != interactions.front().gauge())
+            throw runtime_error("Batched trajectories must share the gauge.");
+    }
+    _S_diag = S.diagonal().real().cast<complex<double>>();
+}
+
+MatrixXcd Batched_runge_kutta4::derivative(const double& time, const MatrixXcd& states) const {
+    const Index K = states.cols();
+
+    Matrix<complex<double>, 3, Dynamic> fields(3, K);
+    for (Index k = 0; k < K; ++k)
+        fields.col(k) = _interactions[k].field(time);
+
+    const Gauge gauge     = _interactions.front().gauge();
+    const bool length     = gauge == Gauge::length;
+    const MatrixXcd* V[3] = {length ? &_ints.Dx : &_ints.Gx, length ? &_ints.Dy : &_ints.Gy,
+                             length ? &_ints.Dz : &_ints.Gz};
+
+    MatrixXcd res = _H0 * states;
+    for (int c = 0; c < 3; ++c) {
+        if (fields.row(c).isZero(0.0))
+            continue;
+        VectorXcd scale = fields.row(c).transpose();
+        if (!length)
+            scale *= -1.0i;
+        res.noalias() += (*V[c] * states) * scale.asDiagonal();
+    }
+    if (gauge == Gauge::velocity_with_Asqrt) {
+        const VectorXcd A2 = (fields.colwise().squaredNorm().transpose() / 2.0).cast<complex<double>>();
+        res += (_ints.S * states) * A2.asDiagonal();
+    }
+
+    res.array().colwise() /= _S_diag.array();
+    return -1.0i * res;
+}
+
+void Batched_runge_kutta4::step(MatrixXcd& states, const double& time, const double& dt) const {
+    const MatrixXcd k1 = derivative(time, states);
+    const MatrixXcd k2 = derivative(time + dt / 2.0, states + dt / 2.0 * k1);
+    const MatrixXcd k3 = derivative(time + dt / 2.0, states + dt / 2.0 * k2);
+    const MatrixXcd k4 = derivative(time + dt, states + dt * k3);
+
+    states += dt / 6.0 * (k1 + 2.0 * k2 + 2.0 * k3 + k4);
+}
+
+Runge_kutta45::Runge_kutta45(const MatrixXcd& S,
+                             const MatrixXcd& H0,
+                             const Interaction& interaction,
+                             const double& tolerance)
+    : Explicit_propagator(S, H0, interaction), _tolerance(tolerance) {}
+
+void Runge_kutta45::step(VectorXcd& state, const double& time, const double& dt) {
+    constexpr double a21 = 1.0 / 5.0;
+    constexpr double a31 = 3.0 / 40.0, a32 = 9.0 / 40.0;
+    constexpr double a41 = 44.0 / 45.0, a42 = -56.0 / 15.0, a43 = 32.0 / 9.0;
+    constexpr double a51 = 19372.0 / 6561.0, a52 = -25360.0 / 2187.0, a53 = 64448.0 / 6561.0, a54 = -212.0 / 729.0;
+    constexpr double a61 = 9017.0 / 3168.0, a62 = -355.0 / 33.0, a63 = 46732.0 / 5247.0, a64 = 49.0 / 176.0,
+                     a65 = -5103.0 / 18656.0;
+    constexpr double b1 = 35.0 / 384.0, b3 = 500.0 / 1113.0, b4 = 125.0 / 192.0, b5 = -2187.0 / 6784.0,
+                     b6 = 11.0 / 84.0;
+    constexpr double e1 = 71.0 / 57600.0, e3 = -71.0 / 16695.0, e4 = 71.0 / 1920.0, e5 = -17253.0 / 339200.0,
+                     e6 = 22.0 / 525.0, e7 = -1.0 / 40.0;
+
+    const double t_end = time + dt;
+    double t           = time;
+    if (_h <= 0.0)
+        _h = dt;
+
+    VectorXcd k1 = derivative(t, state);
+    while (t_end - t > 1.0e-12 * dt) {
+        const bool last = _h >= t_end - t;
+        const double h  = last ? t_end - t : _h;
+
+        const VectorXcd k2 = derivative(t + h / 5.0, state + h * (a21 * k1));
+        const VectorXcd k3 = derivative(t + 3.0 * h / 10.0, state + h * (a31 * k1 + a32 * k2));
+        const VectorXcd k4 = derivative(t + 4.0 * h / 5.0, state + h * (a41 * k1 + a42 * k2 + a43 * k3));
+        const VectorXcd k5 =
+            derivative(t + 8.0 * h / 9.0, state + h * (a51 * k1 + a52 * k2 + a53 * k3 + a54 * k4));
+        const VectorXcd k6 = derivative(t + h, state + h * (a61 * k1 + a62 * k2 + a63 * k3 + a64 * k4 + a65 * k5));
+
+        const VectorXcd y  = state + h * (b1 * k1 + b3 * k3 + b4 * k4 + b5 * k5 + b6 * k6);
+        const VectorXcd k7 = derivative(t + h, y);
+
+        const double err = norm(h * (e1 * k1 + e3 * k3 + e4 * k4 + e5 * k5 + e6 * k6 + e7 * k7)) / _tolerance;
+        if (!isfinite(err))
+            throw runtime_error("RK45 error estimate is not finite, the propagation diverged.");
+        if (err > 1.0 && h <= 1.0e-10 * dt)
+            throw runtime_error("RK45 step size fell below 1e-10 DT without meeting PROPAGATOR_TOLERANCE.");
+        const double fac = err > 0.0 ? min(5.0, max(0.2, 0.9 * pow(err, -0.2))) : 5.0;
+
+        if (err <= 1.0) {
+            t     = last ? t_end : t + h;
+            state = y;
+            k1    = k7;
+            if (!last || fac < 1.0)
+                _h = h * fac;
+        } else {
+            _h = h * fac;
+        }
+    }
+}
+
+Short_iterative_arnoldi::Short_iterative_arnoldi(const MatrixXcd& S,
+                                                 const MatrixXcd& H0,
+                                                 const Interaction& interaction,
+                                                 const int& krylov_dim)
+    : Explicit_propagator(S, H0, interaction), _krylov(_S_diag, krylov_dim, 0.0) {}
+
+void Short_iterative_arnoldi::step(VectorXcd& state, const double& time, const double& dt) {
+    const double t_mid = time + dt / 2.0;
+    _krylov.apply([&](const VectorXcd& v) { return hamiltonian(t_mid, v); }, state, dt);
+}
+
+Krylov_propagator::Krylov_propagator(const MatrixXcd& S,
+                                     const MatrixXcd& H0,
+                                     const Interaction& interaction,
+                                     const int& max_krylov_dim,
+                                     const double& tolerance)
+    : Explicit_propagator(S, H0, interaction), _krylov(_S_diag, max_krylov_dim, tolerance) {}
+
+void Krylov_propagator::step(VectorXcd& state, const double& time, const double& dt) {
+    const double t_mid = time + dt / 2.0;
+    _krylov.apply([&](const VectorXcd& v) { return hamiltonian(t_mid, v); }, state, dt);
+}
+
+void Krylov_propagator::print_statistics(ostream& os) const {
+    _krylov.print_statistics(os);
+}
+
+Field_free_propagator::Field_free_propagator(const MatrixXcd& S, const MatrixXcd& H0, ostream& log) {
+    log << " Diagonalizing field-free Hamiltonian.\n";
+
+    ComplexEigenSolver<MatrixXcd> es(S.partialPivLu().solve(H0));
+    log << "   EigenSolver info: ";
+    if (check_and_report_eigen_info(log, es.info()))
+        throw runtime_error("Diagonalization of the field-free Hamiltonian failed.");
+
+    _W      = es.eigenvectors();
+    _lambda = es.eigenvalues();
+
+    const PartialPivLU<MatrixXcd> W_lu(_W);
+    log << "   Reciprocal condition number of eigenvectors: " << W_lu.rcond() << "\n\n";
+    _W_inv = W_lu.inverse();
+}
+
+void Field_free_propagator::step(VectorXcd& state, const double& time, const double& dt) {
+    state = from_eigenbasis(to_eigenbasis(state), dt);
+}
+
+MatrixXcd Field_free_propagator::to_eigenbasis(const MatrixXcd& states) const {
+    return _W_inv * states;
+}
+
+MatrixXcd Field_free_propagator::from_eigenbasis(const MatrixXcd& coefficients, const double& tau) const {
+    const VectorXcd phases = (-1.0i * tau * _lambda).array().exp();
+    return _W * (phases.asDiagonal() * coefficients);
+}
+
+Interaction_picture::Interaction_picture(const MatrixXcd& S,
+                                         const MatrixXcd& H,
+                                         const MatrixXcd& CAP,
+                                         const Interaction& interaction)
+    : _CAP(CAP), _interaction(interaction) {
+    if (!S.isDiagonal() || !H.isDiagonal())
+        throw runtime_error("Interaction picture propagation requires diagonal S and H, use SPECTRAL_BASIS.");
+    _S_inv    = S.diagonal().cwiseInverse();
+    _energies = H.diagonal().cwiseProduct(_S_inv);
+}
+
+VectorXcd Interaction_picture::coupling_derivative(const double& time, const VectorXcd& state) const {
+    VectorXcd res = _interaction.apply(time, state);
+    if (_CAP.size() > 0)
+        res += _CAP * state;
+    return -1.0i * _S_inv.cwiseProduct(res);
+}
+
+void Interaction_picture::step(VectorXcd& state, const double& time, const double& dt) {
+    const VectorXcd half = (-0.5i * dt * _energies).array().exp();
+    const VectorXcd full = half.cwiseProduct(half);
+
+    const VectorXcd k1 = coupling_derivative(time, state);
+    const VectorXcd k2 = coupling_derivative(time + dt / 2.0, half.cwiseProduct(state + dt / 2.0 * k1));
+    const VectorXcd k3 = coupling_derivative(time + dt / 2.0, half.cwiseProduct(state) + dt / 2.0 * k2);
+    const VectorXcd k4 =
+        coupling_derivative(time + dt, full.cwiseProduct(state) + dt * half.cwiseProduct(k3));
+
+    state = full.cwiseProduct(state) +
+            dt / 6.0 * (full.cwiseProduct(k1) + 2.0 * half.cwiseProduct(k2 + k3) + k4);
+}
+
+Pade_backend::Pade_backend(const MatrixXcd& S, const MatrixXcd& H0, const Interaction& interaction)
+    : _S(S), _H0(H0), _interaction(interaction) {}
+
+void Pade_backend::apply(const Hamiltonian_combination& B, VectorXcd& state, const double& dt) {
+    MatrixXcd B_mat = B.h0_weight * _H0;
+    for (const auto& term : B.interaction_terms)
+        B_mat += term.first * _interaction.matrix(term.second);
+
+    const complex<double> roots[2] = {{3.0, sqrt(3.0)}, {3.0, -sqrt(3.0)}};
+    for (const auto& r : roots) {
+        const MatrixXcd Z = 1.0i * dt / r * B_mat;
+        state             = (_S + Z).partialPivLu().solve((_S - Z) * state);
+    }
+}
+
+Krylov_backend::Krylov_backend(const MatrixXcd& S,
+                               const MatrixXcd& H0,
+                               const Interaction& interaction,
+                               const int& max_krylov_dim,
+                               const double& tolerance)
+    : _H0(H0), _interaction(interaction) {
+    if (!S.isDiagonal())
+        throw runtime_error("Krylov exponential requires diagonal S, cut linear dependencies first.");
+    _S_inv  = S.diagonal().cwiseInverse();
+    _krylov = make_unique<Krylov_exponential>(S.diagonal().real(), max_krylov_dim, tolerance);
+}
+
+void Krylov_backend::apply(const Hamiltonian_combination& B, VectorXcd& state, const double& dt) {
+    auto op = [&](const VectorXcd& v) {
+        VectorXcd res = B.h0_weight * (_H0 * v);
+        for (const auto& term : B.interaction_terms)
+            res += term.first * _interaction.apply(term.second, v);
+        return VectorXcd(_S_inv.cwiseProduct(res));
+    };
+    _krylov->apply(op, state, dt);
+}
+
+void Krylov_backend::print_statistics(ostream& os) const {
+    _krylov->print_statistics(os);
+}
+
+Commutator_free_magnus::Commutator_free_magnus(const int& order, unique_ptr<Exponential_backend> backend)
+    : _order(order), _backend(move(backend)) {
+    if (_order != 4 && _order != 6)
+        throw runtime_error("Commutator-free Magnus integrators are available in orders 4 and 6.");
+}
+
+void Commutator_free_magnus::cfet4_step(VectorXcd& state, const double& time, const double& dt) {
+    const double t1 = time + (0.5 - sqrt(3.0) / 6.0) * dt;
+    const double t2 = time + (0.5 + sqrt(3.0) / 6.0) * dt;
+    const double a1 = 0.25 - sqrt(3.0) / 6.0;
+    const double a2 = 0.25 + sqrt(3.0) / 6.0;
+
+    _backend->apply({0.5, {{a2, t1}, {a1, t2}}}, state, dt);
+    _backend->apply({0.5, {{a1, t1}, {a2, t2}}}, state, dt);
+}
+
+void Commutator_free_magnus::step(VectorXcd& state, const double& time, const double& dt) {
+    if (_order == 4) {
+        cfet4_step(state, time, dt);
+        return;
+    }
+
+    const double g1 = 1.0 / (2.0 - pow(2.0, 1.0 / 5.0));
+    const double g0 = 1.0 - 2.0 * g1;
+    cfet4_step(state, time, g1 * dt);
+    cfet4_step(state, time + g1 * dt, g0 * dt);
+    cfet4_step(state, time + (g1 + g0) * dt, g1 * dt);
+}
+
+void Commutator_free_magnus::print_statistics(ostream& os) const {
+    _backend->print_statistics(os);
+}
@@ -0,0 +1,299 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <eigen3/Eigen/Dense>
+
+#include "interaction.h"
+#include "krylov.h"
+
+class Time_propagator {
+   public:
+    virtual ~Time_propagator() = default;
+
+    // advances state from time to time + dt
+    virtual void step(Eigen::VectorXcd& state, const double& time, const double& dt) = 0;
+
+    // advances every column of states, one orbital each; column by column unless the
+    // propagator can share its per-step work between them
+    virtual void step_block(Eigen::MatrixXcd& states, const double& time, const double& dt);
+
+    // order of the local time discretization error, used by step size control
+    virtual int order() const { return 2; }
+
+    virtual void print_statistics(std::ostream& os) const {}
+};
+
+// (S + i dt/2 H(t)) psi(t + dt) = (S - i dt/2 H(t)) psi(t), with H(t) = H0 + H_int(t + dt),
+// one LU factorization per step. The factorization is kept and reused as long as dt and the
+// field stay exactly the same, e.g. after the pulse, so constant segments cost only O(N^2).
+// A block of orbitals is solved as one multi-RHS system with the same factorization.
+class Crank_nicolson : public Time_propagator {
+   public:
+    Crank_nicolson(const Eigen::MatrixXcd& S, const Eigen::MatrixXcd& H0, const Interaction& interaction);
+
+    void step(Eigen::VectorXcd& state, const double& time, const double& dt) override;
+    void step_block(Eigen::MatrixXcd& states, const double& time, const double& dt) override;
+
+    void print_statistics(std::ostream& os) const override;
+
+   private:
+    void factorize(const double& time, const double& dt);
+
+    const Eigen::MatrixXcd& _S;
+    const Eigen::MatrixXcd _H0;
+    const Interaction& _interaction;
+
+    bool _cached{false};
+    double _cached_dt{0.0};
+    Eigen::Vector3cd _cached_field{};
+    Eigen::PartialPivLU<Eigen::MatrixXcd> _A_lu{};
+    Eigen::MatrixXcd _B{};
+
+    long _hits{0};
+    long _misses{0};
+};
+
+// Crank-Nicolson for H_int(t) = f(t) V with constant V. The pencil M0 + f M1, where
+// M0 = S + i dt/2 H0 and M1 = i dt/2 V, is diagonalized once: M0^-1 M1 = X L X^-1,
+// so each step costs O(N^2) instead of O(N^3).
+class Crank_nicolson_pencil : public Time_propagator {
+   public:
+    Crank_nicolson_pencil(const Eigen::MatrixXcd& S,
+                          const Eigen::MatrixXcd& H0,
+                          const Interaction& interaction,
+                          const double& dt,
+                          std::ostream& log);
+
+    void step(Eigen::VectorXcd& state, const double& time, const double& dt) override;
+    void step_block(Eigen::MatrixXcd& states, const double& time, const double& dt) override;
+
+   private:
+    const Interaction& _interaction;
+    const double _dt;
+
+    Eigen::MatrixXcd _X{};
+    Eigen::PartialPivLU<Eigen::MatrixXcd> _X_lu{};
+    Eigen::MatrixXcd _P{};  // X^-1 M0^-1 (S - i dt/2 H0)
+    Eigen::VectorXcd _lambda{};
+};
+
+// base for propagators built only from Hamiltonian matvecs; requires diagonal S,
+// as left by Integrals::cut_linear_dependencies
+class Explicit_propagator : public Time_propagator {
+   public:
+    Explicit_propagator(const Eigen::MatrixXcd& S, const Eigen::MatrixXcd& H0, const Interaction& interaction);
+
+   protected:
+    // S^-1 H(t) state
+    Eigen::VectorXcd hamiltonian(const double& time, const Eigen::VectorXcd& state) const;
+    // -i S^-1 H(t) state
+    Eigen::VectorXcd derivative(const double& time, const Eigen::VectorXcd& state) const;
+    // S-norm, so that errors are measured like compute_norm
+    double norm(const Eigen::VectorXcd& state) const;
+
+    Eigen::VectorXd _S_diag{};
+    const Eigen::MatrixXcd _H0;
+    const Interaction& _interaction;
+};
+
+class Runge_kutta4 : public Explicit_propagator {
+   public:
+    using Explicit_propagator::Explicit_propagator;
+
+    void step(Eigen::VectorXcd& state, const double& time, const double& dt) override;
+
+    int order() const override { return 4; }
+};
+
+// Runge-Kutta 4 for K trajectories with the same operators and gauge but different pulses,
+// e.g. the points of a laser parameter sweep. The states are the columns of one N x K matrix,
+// so every operator is streamed once per stage for all of them: H0 and Dx, Dy, Dz (or G) act as
+// N x N times N x K products and the fields of each trajectory only scale columns. Requires
+// diagonal S, like Explicit_propagator.
+class Batched_runge_kutta4 {
+   public:
+    Batched_runge_kutta4(const Eigen::MatrixXcd& S,
+                         const Eigen::MatrixXcd& H0,
+                         const Integrals& ints,
+                         const std::vector<Interaction>& interactions);
+
+    // advances column k of states with interactions[k] from time to time + dt
+    void step(Eigen::MatrixXcd& states, const double& time, const double& dt) const;
+
+   private:
+    // -i S^-1 H_k(t) states_k for every column k
+    Eigen::MatrixXcd derivative(const double& time, const Eigen::MatrixXcd& states) const;
+
+    Eigen::VectorXcd _S_diag{};
+    const Eigen::MatrixXcd& _H0;
+    const Integrals& _ints;
+    const std::vector<Interaction>& _interactions;
+};
+
+// Dormand-Prince 5(4) with embedded error estimate; substeps inside [time, time + dt]
+class Runge_kutta45 : public Explicit_propagator {
+   public:
+    Runge_kutta45(const Eigen::MatrixXcd& S,
+                  const Eigen::MatrixXcd& H0,
+                  const Interaction& interaction,
+                  const double& tolerance);
+
+    void step(Eigen::VectorXcd& state, const double& time, const double& dt) override;
+
+    int order() const override { return 5; }
+
+   private:
+    const double _tolerance;
+    double _h{0.0};
+};
+
+// exponential midpoint rule, exp(-i dt S^-1 H(t + dt/2)) evaluated in a fixed-dimension
+// Arnoldi space; Arnoldi rather than Lanczos since CAP makes H non-Hermitian
+class Short_iterative_arnoldi : public Explicit_propagator {
+   public:
+    Short_iterative_arnoldi(const Eigen::MatrixXcd& S,
+                            const Eigen::MatrixXcd& H0,
+                            const Interaction& interaction,
+                            const int& krylov_dim);
+
+    void step(Eigen::VectorXcd& state, const double& time, const double& dt) override;
+
+   private:
+    Krylov_exponential _krylov;
+};
+
+// exponential midpoint rule with adaptive Krylov dimension and substeps, allows steps
+// much larger than the Crank-Nicolson ones at the same accuracy
+class Krylov_propagator : public Explicit_propagator {
+   public:
+    Krylov_propagator(const Eigen::MatrixXcd& S,
+                      const Eigen::MatrixXcd& H0,
+                      const Interaction& interaction,
+                      const int& max_krylov_dim,
+                      const double& tolerance);
+
+    void step(Eigen::VectorXcd& state, const double& time, const double& dt) override;
+
+    void print_statistics(std::ostream& os) const override;
+
+   private:
+    Krylov_exponential _krylov;
+};
+
+// exact evolution with the time independent H0 = H + CAP, valid once the pulse is over:
+// S^-1 H0 = W L W^-1 is diagonalized once and psi(t0 + tau) = W exp(-i L tau) W^-1 psi(t0)
+class Field_free_propagator : public Time_propagator {
+   public:
+    Field_free_propagator(const Eigen::MatrixXcd& S, const Eigen::MatrixXcd& H0, std::ostream& log);
+
+    void step(Eigen::VectorXcd& state, const double& time, const double& dt) override;
+
+    // W^-1 states, one column per orbital
+    Eigen::MatrixXcd to_eigenbasis(const Eigen::MatrixXcd& states) const;
+    // W exp(-i L tau) coefficients
+    Eigen::MatrixXcd from_eigenbasis(const Eigen::MatrixXcd& coefficients, const double& tau) const;
+
+   private:
+    Eigen::MatrixXcd _W{};
+    Eigen::MatrixXcd _W_inv{};
+    Eigen::VectorXcd _lambda{};
+};
+
+// Lawson (integrating factor) Runge-Kutta 4 in the interaction picture of diagonal S^-1 H,
+// as given by SPECTRAL_BASIS. exp(-i S^-1 H t) is applied exactly and only V(t) = CAP + H_int(t)
+// is integrated, so the step is not limited by the highest eigenvalues of H.
+class Interaction_picture : public Time_propagator {
+   public:
+    Interaction_picture(const Eigen::MatrixXcd& S,
+                        const Eigen::MatrixXcd& H,
+                        const Eigen::MatrixXcd& CAP,
+                        const Interaction& interaction);
+
+    void step(Eigen::VectorXcd& state, const double& time, const double& dt) override;
+
+    int order() const override { return 4; }
+
+   private:
+    // -i S^-1 V(t) state
+    Eigen::VectorXcd coupling_derivative(const double& time, const Eigen::VectorXcd& state) const;
+
+    Eigen::VectorXcd _S_inv{};
+    Eigen::VectorXcd _energies{};
+    const Eigen::MatrixXcd& _CAP;
+    const Interaction& _interaction;
+};
+
+// B = h0_weight H0 + sum_k w_k H_int(t_k), the terms are pairs (w_k, t_k)
+struct Hamiltonian_combination {
+    double h0_weight{1.0};
+    std::vector<std::pair<double, double>> interaction_terms{};
+};
+
+// action of exp(-i dt S^-1 B) on a state
+class Exponential_backend {
+   public:
+    virtual ~Exponential_backend() = default;
+
+    virtual void apply(const Hamiltonian_combination& B, Eigen::VectorXcd& state, const double& dt) = 0;
+
+    virtual void print_statistics(std::ostream& os) const {}
+};
+
+// (2,2) Pade approximant, factorized as two Cayley-like factors
+// prod_k (S + i dt B / r_k)^-1 (S - i dt B / r_k) with r = 3 +- i sqrt(3); 4th order and unitary
+// for Hermitian B, costs two LU factorizations
+class Pade_backend : public Exponential_backend {
+   public:
+    Pade_backend(const Eigen::MatrixXcd& S, const Eigen::MatrixXcd& H0, const Interaction& interaction);
+
+    void apply(const Hamiltonian_combination& B, Eigen::VectorXcd& state, const double& dt) override;
+
+   private:
+    const Eigen::MatrixXcd& _S;
+    const Eigen::MatrixXcd& _H0;
+    const Interaction& _interaction;
+};
+
+// adaptive Krylov space with matvecs only, requires diagonal S
+class Krylov_backend : public Exponential_backend {
+   public:
+    Krylov_backend(const Eigen::MatrixXcd& S,
+                   const Eigen::MatrixXcd& H0,
+                   const Interaction& interaction,
+                   const int& max_krylov_dim,
+                   const double& tolerance);
+
+    void apply(const Hamiltonian_combination& B, Eigen::VectorXcd& state, const double& dt) override;
+
+    void print_statistics(std::ostream& os) const override;
+
+   private:
+    Eigen::VectorXcd _S_inv{};
+    const Eigen::MatrixXcd& _H0;
+    const Interaction& _interaction;
+    std::unique_ptr<Krylov_exponential> _krylov{};
+};
+
+// commutator-free Magnus integrators with H(t) sampled at Gauss points. CFET4 is
+// exp(-i dt (a1 H1 + a2 H2)) exp(-i dt (a2 H1 + a1 H2)), a1,2 = 1/4 -+ sqrt(3)/6; the 6th order
+// scheme is the symmetric triple jump composition of CFET4 steps
+class Commutator_free_magnus : public Time_propagator {
+   public:
+    Commutator_free_magnus(const int& order, std::unique_ptr<Exponential_backend> backend);
+
+    void step(Eigen::VectorXcd& state, const double& time, const double& dt) override;
+
+    int order() const override { return _order; }
+
+    void print_statistics(std::ostream& os) const override;
+
+   private:
+    void cfet4_step(Eigen::VectorXcd& state, const double& time, const double& dt);
+
+    const int _order;
+    std::unique_ptr<Exponential_backend> _backend;
+};
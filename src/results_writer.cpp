@@ -0,0 +1,169 @@
+#include "results_writer.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace Eigen;
+
+namespace {
+
+constexpr double flush_interval = 1.0;  // s
+
+Observables observables_of(const double* values, const size_t& columns) {
+    Observables obs;
+    obs.time   = values[0];
+    obs.dipole = Vector3d(values[1], values[2], values[3]);
+    obs.norm   = values[4];
+    obs.energy = values[5];
+    obs.hint   = values[6];
+    if (columns == 10)
+        obs.velocity = Vector3d(values[7], values[8], values[9]);
+    return obs;
+}
+
+void write_text_record(ostream& os, const double* values, const size_t& columns) {
+    os << scientific << setprecision(5) << setw(13) << values[0] << "   ";
+    for (size_t k = 1; k < columns; ++k)
+        os << setw(14) << values[k];
+    os << '\n';
+}
+
+}  // namespace
+
+string results_header_text(const Control_data& control) {
+    ostringstream os;
+    os << scientific;
+    os << control;
+    os << "#        time             dipx          dipy          dipz          norm        energy        <Hint>";
+    if (control.velocity_dipole)
+        os << "          velx          vely          velz";
+    os << '\n';
+    return os.str();
+}
+
+Results_writer::Results_writer(const Control_data& control, const std::uint64_t& resume_offset)
+    : _format(control.results_format),
+      _velocity(control.velocity_dipole),
+      _path(control.out_path + "/" + control.out_file) {
+    if (resume_offset > 0) {
+        if (truncate(_path.c_str(), resume_offset) != 0)
+            throw runtime_error("Cannot truncate results file for restart: " + _path);
+        _file.open(_path, ios::in | ios::out | ios::binary);
+        if (!_file.is_open())
+            throw runtime_error("Cannot open results file: " + _path);
+        _file.seekp(resume_offset);
+        return;
+    }
+
+    _file.open(_path, ios::out | ios::binary | ios::trunc);
+    if (!_file.is_open())
+        throw runtime_error("Cannot open results file: " + _path);
+
+    string text = results_header_text(control);
+    if (_format == Results_format::binary) {
+        text.resize((text.size() + 7) / 8 * 8, '\0');
+
+        Results_header header;
+        header.columns   = _velocity ? 10 : 7;
+        header.text_size = text.size();
+        _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    _file.write(text.data(), text.size());
+    _file.flush();
+}
+
+void Results_writer::append(const Observables& obs) {
+    const double values[10] = {obs.time,   obs.dipole(0), obs.dipole(1),   obs.dipole(2),   obs.norm,
+                               obs.energy, obs.hint,      obs.velocity(0), obs.velocity(1), obs.velocity(2)};
+    const size_t columns    = _velocity ? 10 : 7;
+
+    if (_format == Results_format::binary)
+        _file.write(reinterpret_cast<const char*>(values), columns * sizeof(double));
+    else
+        write_text_record(_file, values, columns);
+
+    if (_since_flush.duration().count() >= flush_interval) {
+        _file.flush();
+        _since_flush.restart();
+    }
+    if (!_file)
+        throw runtime_error("Writing results failed: " + _path);
+}
+
+std::uint64_t Results_writer::synchronize() {
+    _file.flush();
+    _since_flush.restart();
+    if (!_file)
+        throw runtime_error("Writing results failed: " + _path);
+    return _file.tellp();
+}
+
+void Results_writer::close() {
+    _file.close();
+    if (!_file)
+        throw runtime_error("Writing results failed: " + _path);
+}
+
+void export_results_text(const string& path, ostream& os) {
+    ifstream file(path, ios::in | ios::binary);
+    if (!file.is_open())
+        throw runtime_error("Cannot open results file: " + path);
+
+    Results_header header;
+    const Results_header reference;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || !equal(begin(reference.magic), end(reference.magic), begin(header.magic)) ||
+        header.version != reference.version)
+        throw runtime_error("Not a binary results file of this version: " + path);
+
+    string text(header.text_size, '\0');
+    file.read(&text[0], text.size());
+    os << text.c_str();
+
+    vector<double> record(header.columns);
+    while (file.read(reinterpret_cast<char*>(record.data()), record.size() * sizeof(double)))
+        write_text_record(os, record.data(), record.size());
+}
+
+vector<Observables> read_results(const string& path) {
+    ifstream file(path, ios::in | ios::binary);
+    if (!file.is_open())
+        throw runtime_error("Cannot open results file: " + path);
+
+    vector<Observables> samples;
+    Results_header header;
+    const Results_header reference;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (file && equal(begin(reference.magic), end(reference.magic), begin(header.magic))) {
+        if (header.version != reference.version)
+            throw runtime_error("Not a binary results file of this version: " + path);
+        file.seekg(sizeof(header) + header.text_size);
+
+        vector<double> record(header.columns);
+        while (file.read(reinterpret_cast<char*>(record.data()), record.size() * sizeof(double)))
+            samples.push_back(observables_of(record.data(), record.size()));
+        return samples;
+    }
+
+    file.clear();
+    file.seekg(0);
+    string line;
+    while (getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        istringstream is(line);
+        vector<double> record;
+        for (double value; is >> value;)
+            record.push_back(value);
+        if (record.size() != 7 && record.size() != 10)
+            throw runtime_error("Malformed line in results file " + path + ": " + line);
+        samples.push_back(observables_of(record.data(), record.size()));
+    }
+    return samples;
+}
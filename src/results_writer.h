@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "control_data.h"
+#include "observables.h"
+#include "utils.h"
+
+// Binary results file (RESULTS_FORMAT binary). Layout:
+//   Results_header                  magic, version, number of columns, length of the text
+//   text                            Control_data echo and the column names line, as in the text
+//                                   results, zero padded to a multiple of 8 bytes
+//   records                         columns doubles each: time, dipx, dipy, dipz, norm, energy,
+//                                   <Hint> and velx, vely, velz with VELOCITY_DIPOLE
+// The number of records follows from the file size, a partial last record is ignored.
+struct Results_header {
+    char magic[8]{'P', 'T', 'D', 'R', 'E', 'S', 0, 0};
+    std::uint32_t version{1};
+    std::uint32_t columns{0};
+    std::uint64_t text_size{0};
+};
+
+// Appends every registered sample to OUT_PATH/OUT_FILE as it comes, in text or binary. The
+// file is flushed at least once per second, so a crashed run keeps nearly all its results.
+class Results_writer {
+   public:
+    // with a non-zero resume offset an existing file is truncated there and continued, as
+    // needed for a restart from a checkpoint
+    Results_writer(const Control_data& control, const std::uint64_t& resume_offset = 0);
+
+    void append(const Observables& obs);
+
+    // flushes, returns the size of the file so far
+    std::uint64_t synchronize();
+
+    void close();
+
+   private:
+    const Results_format _format;
+    const bool _velocity;
+    const std::string _path;
+    std::ofstream _file{};
+    Clock _since_flush{};
+};
+
+// header text of the results: Control_data echo and the column names line
+std::string results_header_text(const Control_data& control);
+
+// writes a binary results file as the text results
+void export_results_text(const std::string& path, std::ostream& os);
+
+// samples of a text or binary results file
+std::vector<Observables> read_results(const std::string& path);
@@ -0,0 +1,86 @@
+#include "task_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+struct Task_queue {
+    mutex lock;
+    deque<function<void()>> tasks;
+};
+
+}  // namespace
+
+Task_pool::Task_pool(const int& threads) : _threads(threads) {
+    if (threads < 1)
+        throw runtime_error("Task pool needs at least one thread.");
+}
+
+void Task_pool::run(vector<function<void()>> tasks) const {
+    const int workers = min<int>(_threads, tasks.size());
+    if (workers == 0)
+        return;
+
+    // contiguous blocks, so that a worker runs neighbouring tasks while there is nothing to steal
+    vector<unique_ptr<Task_queue>> queues;
+    for (int w = 0; w < workers; ++w)
+        queues.push_back(make_unique<Task_queue>());
+    for (size_t t = 0; t < tasks.size(); ++t)
+        queues[t * workers / tasks.size()]->tasks.push_back(move(tasks[t]));
+
+    // own tasks are taken from the front, stolen ones from the back of the victim's queue
+    auto take = [&](const int& w, function<void()>& task) {
+        for (int i = 0; i < workers; ++i) {
+            auto& queue = *queues[(w + i) % workers];
+            lock_guard<mutex> guard(queue.lock);
+            if (queue.tasks.empty())
+                continue;
+            if (i == 0) {
+                task = move(queue.tasks.front());
+                queue.tasks.pop_front();
+            } else {
+                task = move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    };
+
+    atomic<bool> failed{false};
+    exception_ptr error;
+    mutex error_lock;
+
+    auto work = [&](const int w) {
+        function<void()> task;
+        while (!failed && take(w, task)) {
+            try {
+                task();
+            } catch (...) {
+                lock_guard<mutex> guard(error_lock);
+                if (!error)
+                    error = current_exception();
+                failed = true;
+            }
+        }
+    };
+
+    vector<thread> threads;
+    for (int w = 1; w < workers; ++w)
+        threads.emplace_back(work, w);
+    work(0);
+    for (auto& worker : threads)
+        worker.join();
+
+    if (error)
+        rethrow_exception(error);
+}
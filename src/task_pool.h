@@ -0,0 +1,19 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+// Runs independent tasks on a fixed number of threads. Every worker starts with an even share
+// of the tasks and, once its own are done, steals from the workers that are still busy, so that
+// tasks of very different cost still keep all threads working.
+class Task_pool {
+   public:
+    explicit Task_pool(const int& threads);
+
+    // returns when all tasks are done; if a task throws, the remaining ones are not started and
+    // the first exception is rethrown
+    void run(std::vector<std::function<void()>> tasks) const;
+
+   private:
+    int _threads;
+};
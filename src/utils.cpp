@@ -1,5 +1,7 @@
 #include "utils.h"
 
+#include <cstring>
+
 std::chrono::duration<double> Clock::restart() {
     const auto dur = duration();
     _start         = std::chrono::system_clock::now();
@@ -43,4 +45,37 @@ void punch_xgtopw_header(std::ofstream& ofs, const Control_data& control) {
     ofs << "$POINTS\n"
         << "1\n0.000 0.000 0.000\n"
         << "$END\n";
-}
\ No newline at end of file
+}
+
+namespace {
+
+// splitmix64 finalizer, every input bit affects every output bit
+std::uint64_t avalanche(std::uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+}  // namespace
+
+std::uint64_t hash_bytes(const void* data, const std::size_t& size, std::uint64_t seed) {
+    constexpr std::uint64_t increment = 0x9e3779b97f4a7c15ull;
+    const auto bytes                  = static_cast<const unsigned char*>(data);
+
+    std::uint64_t h = seed;
+    std::size_t i   = 0;
+    for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t)) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        h = avalanche(h ^ word) + increment;
+    }
+    if (i < size) {
+        std::uint64_t word = 0;
+        std::memcpy(&word, bytes + i, size - i);
+        h = avalanche(h ^ word) + increment;
+    }
+    return avalanche(h ^ size);
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <fstream>
 
@@ -41,3 +43,7 @@ std::ostream& operator<<(std::ostream& os, const Clock& rhs);
 
 
 void punch_xgtopw_header(std::ofstream &ofs, const Control_data& control);
+
+// 64-bit hash processed in 8 byte words, each mixed in with the splitmix64 finalizer; used for
+// checksums and cache keys
+std::uint64_t hash_bytes(const void* data, const std::size_t& size, std::uint64_t seed = 14695981039346656037ull);